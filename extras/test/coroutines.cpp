@@ -0,0 +1,81 @@
+// Drive the awaitable display operations on the host, with loop() as the
+// executor, and check the order in which the coroutines are resumed.
+
+#include <V2Display.h>
+#include <stdio.h>
+
+// Every write keeps the bus busy for a few polls, like a running transfer.
+class Transport : public V2Display::SimulatorTransport {
+public:
+  Transport(uint16_t *pixels) : SimulatorTransport(pixels, 240, 320) {}
+
+  void write(const void *buffer, uint16_t len) override {
+    SimulatorTransport::write(buffer, len);
+    _polls = 3;
+  }
+
+  bool isBusy() override {
+    if (_polls == 0)
+      return false;
+
+    _polls--;
+    return true;
+  }
+
+private:
+  uint8_t _polls{};
+};
+
+static uint16_t pixels[240 * 320];
+static Transport transport(pixels);
+static V2Display::ST7789 display(240, 240, false, &transport, -1);
+static V2Display::TextArea a(&display);
+static V2Display::TextArea b(&display);
+static char trace[128];
+
+static void mark(const char *s) {
+  strcat(trace, s);
+  strcat(trace, " ");
+}
+
+static V2Display::Task first() {
+  co_await display.fillRectangleAsync(0, 0, 240, 60, V2Display::Red);
+  mark("fill");
+  co_await a.printAsync("one");
+  mark("a1");
+  co_await a.printAsync("two");
+  mark("a2");
+  co_await display.flush();
+  mark("flush1");
+}
+
+static V2Display::Task second() {
+  co_await b.printAsync("other");
+  mark("b");
+  co_await display.flush();
+  mark("flush2");
+}
+
+int main() {
+  display.begin();
+  display.reset(0, V2Display::Black);
+  a.set(0, 0, 240, V2Display::Center, V2Display::White, V2Display::Black);
+  b.set(0, 1, 240, V2Display::Center, V2Display::White, V2Display::Black);
+
+  first();
+  second();
+  mark("started");
+
+  for (uint16_t i = 0; i < 1000; i++)
+    display.loop();
+
+  // Every coroutine resumes right after its own job, b before the queued jobs of a.
+  static const char expected[] = "started fill b a1 a2 flush1 flush2 ";
+  if (strcmp(trace, expected) != 0) {
+    printf("coroutines: FAIL\n  expected: %s\n  resumed:  %s\n", expected, trace);
+    return 1;
+  }
+
+  printf("coroutines: ok\n");
+  return 0;
+}
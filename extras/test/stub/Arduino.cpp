@@ -0,0 +1,19 @@
+#include <Arduino.h>
+
+// Time advances with every call, loops which wait for it terminate.
+static uint32_t now_usec;
+
+void yield() {
+  now_usec++;
+}
+
+void delay(uint32_t ms) {
+  now_usec += ms * 1000;
+}
+
+uint32_t micros() {
+  return now_usec++;
+}
+
+void pinMode(uint32_t, uint32_t) {}
+void digitalWrite(uint32_t, uint32_t) {}
@@ -0,0 +1,33 @@
+// Host build of the library: the parts of the Arduino core it uses.
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <type_traits>
+
+typedef bool boolean;
+
+#define HIGH   1
+#define LOW    0
+#define OUTPUT 1
+
+#define min(a, b)                 ((a) < (b) ? (a) : (b))
+#define max(a, b)                 ((a) > (b) ? (a) : (b))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+void yield();
+void delay(uint32_t ms);
+uint32_t micros();
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t value);
+
+enum SercomSpiTXPad { SPI_PAD_0_SCK_1 };
+enum SercomRXPad { SERCOM_RX_PAD_3 };
+enum SercomClockSource { SERCOM_CLOCK_SOURCE_FCPU };
+enum EPioType { PIO_SERCOM };
+
+class SERCOM {};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace V2Base {
+template <typename T, size_t N> constexpr size_t countof(T (&)[N]) {
+  return N;
+}
+};
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <Arduino.h>
+
+inline void pinPeripheral(uint32_t, EPioType) {}
@@ -0,0 +1,140 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#include "V2Display.h"
+#include "font/Font.h"
+
+// The cache has one entry per digit, followed by the blank digit.
+static constexpr uint8_t blank = 10;
+
+bool V2Display::Digits::begin(uint16_t *cache,
+                              uint32_t cache_size,
+                              uint16_t x,
+                              uint8_t row,
+                              uint8_t n_digits,
+                              uint16_t foreground,
+                              uint16_t background,
+                              const Font *font) {
+  // The widest digit, and the union of the vertical extent of all digits.
+  int8_t top    = 0;
+  int8_t bottom = INT8_MIN;
+  uint8_t width = 0;
+  for (char c = '0'; c <= '9'; c++) {
+    const Font::Glyph *glyph = font->getGlyph(c);
+    width                    = max(width, glyph->advance);
+    top                      = min(top, glyph->yStart);
+    bottom                   = max(bottom, glyph->yStart + glyph->height);
+  }
+
+  // Keep the current cache if it is large enough, the previous configuration
+  // stays intact if the new one fails.
+  const uint32_t size = (blank + 1) * width * (bottom - top);
+  if (cache) {
+    if (cache_size < size)
+      return false;
+
+    if (_allocated)
+      free(_cache);
+
+    _cache      = cache;
+    _cache_size = cache_size;
+    _allocated  = false;
+
+  } else if (_cache_size < size) {
+    uint16_t *allocated = (uint16_t *)malloc(size * sizeof(uint16_t));
+    if (!allocated)
+      return false;
+
+    if (_allocated)
+      free(_cache);
+
+    _cache      = allocated;
+    _cache_size = size;
+    _allocated  = true;
+  }
+
+  _font     = font;
+  _x        = x;
+  _row      = row;
+  _n_digits = min(n_digits, sizeof(_shown));
+  _width    = width;
+  _top      = Display::baseline + top;
+  _height   = bottom - top;
+
+  setColors(foreground, background);
+  return true;
+}
+
+void V2Display::Digits::setColors(uint16_t foreground, uint16_t background) {
+  if (!_cache)
+    return;
+
+  _foreground = foreground;
+  _background = background;
+  _level      = _display->_brightness.level;
+
+  const uint16_t size = _width * _height;
+  for (uint8_t d = 0; d <= blank; d++) {
+    uint16_t *pixels = _cache + (d * size);
+    for (uint16_t i = 0; i < size; i++)
+      pixels[i] = _display->dim(background);
+
+    if (d == blank)
+      continue;
+
+    const char c          = '0' + d;
+    const uint8_t padding = (_width - _font->getGlyph(c)->advance) / 2;
+    Display::renderChar(pixels, _font, _width, padding, Display::baseline - _top, c, _display->dim(foreground), 0, _width);
+  }
+
+  memset(_shown, 0xff, sizeof(_shown));
+}
+
+// 26 * 36 * 16bit = 14976 bits
+// 14976 bits / 60Mhz = 0.25 ms
+void V2Display::Digits::print(uint32_t value) {
+  if (!_cache)
+    return;
+
+  // The brightness of the display has changed, show all digits again.
+  if (_level != _display->_brightness.level)
+    setColors(_foreground, _background);
+
+  // The first update clears the entire text row around the digits.
+  if (_shown[0] == 0xff)
+    _display->fillRectangle(_x, _row * Display::row_size, _n_digits * _width, Display::row_size, _background);
+
+  uint8_t digits[sizeof(_shown)];
+  for (int8_t i = _n_digits - 1; i >= 0; i--) {
+    if (value == 0 && i < _n_digits - 1)
+      digits[i] = blank;
+
+    else
+      digits[i] = value % 10;
+
+    value /= 10;
+  }
+
+  // Show all nines if the value does not fit.
+  if (value > 0)
+    memset(digits, 9, _n_digits);
+
+  bool prepared = false;
+  for (uint8_t i = 0; i < _n_digits; i++) {
+    if (digits[i] == _shown[i])
+      continue;
+
+    if (!prepared) {
+      _display->prepareWrite();
+      prepared = true;
+    }
+
+    const uint16_t size = _width * _height;
+    _display->writeSetWindow(_x + (i * _width), (_row * Display::row_size) + _top, _width, _height);
+    _display->write(_cache + (digits[i] * size), size * sizeof(uint16_t));
+    _shown[i] = digits[i];
+  }
+
+  if (prepared)
+    _display->_busy = true;
+}
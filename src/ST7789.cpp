@@ -27,6 +27,10 @@ enum {
   CMD_TEON       = 0x35,
   CMD_MADCTL     = 0x36,
   CMD_COLMOD     = 0x3a,
+  CMD_WRDISBV    = 0x51,
+  CMD_WRCTRLD    = 0x53,
+  CMD_WRCTRLD_BL = 0x04,
+  CMD_WRCTRLD_BC = 0x20,
   CMD_MADCTL_MY  = 0x80,
   CMD_MADCTL_MX  = 0x40,
   CMD_MADCTL_MV  = 0x20,
@@ -50,23 +54,43 @@ void V2Display::ST7789::sleep(boolean on) {
   finishWrite();
 }
 
+void V2Display::ST7789::useBrightnessControl(bool on) {
+  if (on == _brightness.hardware)
+    return;
+
+  // Restore full brightness with the current method, and apply the level with
+  // the new one.
+  const uint8_t level = _brightness.level;
+  setBrightness(255);
+  _brightness.hardware = on;
+  setBrightness(level);
+}
+
+void V2Display::ST7789::writeSetBrightness(uint8_t level) {
+  const uint8_t control = CMD_WRCTRLD_BC | CMD_WRCTRLD_BL;
+  writeCommand(CMD_WRCTRLD, &control, 1);
+  writeCommand(CMD_WRDISBV, &level, 1);
+}
+
 void V2Display::ST7789::writeSetWindow(uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
+  writeWindow(x + _pixels.x_start, y + _pixels.y_start, width, height);
+}
+
+void V2Display::ST7789::writeWindow(uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
   uint8_t data[4];
 
-  const uint16_t x_start = x + _pixels.x_start;
-  data[0]                = x_start >> 8;
-  data[1]                = x_start & 0xff;
-  const uint16_t x_end   = x_start + width - 1;
-  data[2]                = x_end >> 8;
-  data[3]                = x_end & 0xff;
+  data[0]              = x >> 8;
+  data[1]              = x & 0xff;
+  const uint16_t x_end = x + width - 1;
+  data[2]              = x_end >> 8;
+  data[3]              = x_end & 0xff;
   writeCommand(CMD_CASET, data, 4);
 
-  const uint16_t y_start = y + _pixels.y_start;
-  data[0]                = y_start >> 8;
-  data[1]                = y_start & 0xff;
-  const uint16_t y_end   = y_start + height - 1;
-  data[2]                = y_end >> 8;
-  data[3]                = y_end & 0xff;
+  data[0]              = y >> 8;
+  data[1]              = y & 0xff;
+  const uint16_t y_end = y + height - 1;
+  data[2]              = y_end >> 8;
+  data[3]              = y_end & 0xff;
   writeCommand(CMD_RASET, data, 4);
 
   writeCommand(CMD_RAMWR);
@@ -0,0 +1,388 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#include "V2Display.h"
+#include <wiring_private.h>
+
+#ifdef ARDUINO_ARCH_SAMD
+static Sercom *getRegisters(SERCOM *sercom) {
+#ifdef SERCOM0
+  if (sercom == &sercom0)
+    return SERCOM0;
+#endif
+
+#ifdef SERCOM1
+  if (sercom == &sercom1)
+    return SERCOM1;
+#endif
+
+#ifdef SERCOM2
+  if (sercom == &sercom2)
+    return SERCOM2;
+#endif
+
+#ifdef SERCOM3
+  if (sercom == &sercom3)
+    return SERCOM3;
+#endif
+
+#ifdef SERCOM4
+  if (sercom == &sercom4)
+    return SERCOM4;
+#endif
+
+#ifdef SERCOM5
+  if (sercom == &sercom5)
+    return SERCOM5;
+#endif
+
+  return NULL;
+}
+#endif
+
+// Build SPI bus from SERCOM.
+//
+// SPIClass.begin() applies the board config to all given pins, which might not
+// match our configuration. Just pass the same pin to all of them, to make sure
+// we do not touch anything else. Our pin will be switched to the SERCOM after
+// begin().
+static SPIClass *beginSPI(SERCOM *sercom, uint8_t pin_data, SercomSpiTXPad pad_tx) {
+  SPIClass *spi = new SPIClass(sercom, pin_data, pin_data, pin_data, pad_tx, SERCOM_RX_PAD_3);
+
+  // Use faster clock, the transaction requests 60 Mhz.
+  spi->setClockSource(SERCOM_CLOCK_SOURCE_FCPU);
+  spi->begin();
+  return spi;
+}
+
+void V2Display::Output::begin(int8_t pin, bool high) {
+  if (pin < 0)
+    return;
+
+  pinMode(pin, OUTPUT);
+
+#ifdef ARDUINO_ARCH_SAMD
+  PortGroup *group = &PORT->Group[g_APinDescription[pin].ulPort];
+  _set             = &group->OUTSET.reg;
+  _clear           = &group->OUTCLR.reg;
+  _mask            = 1UL << g_APinDescription[pin].ulPin;
+#else
+  _pin = pin;
+#endif
+
+  write(high);
+}
+
+void V2Display::SPITransport::begin() {
+  _output.cs.begin(_pin.cs, true);
+  _output.dc.begin(_pin.dc, true);
+
+  if (!_spi) {
+    _spi = beginSPI(_sercom.sercom, _sercom.pin.data, _sercom.pad_tx);
+
+    pinPeripheral(_sercom.pin.data, _sercom.pin_func);
+    pinPeripheral(_sercom.pin.clock, _sercom.pin_func);
+
+#ifdef ARDUINO_ARCH_SAMD
+    // We own the SERCOM, bypass SPIClass for the single byte transfers.
+    _regs = getRegisters(_sercom.sercom);
+#endif
+    return;
+  }
+
+  _spi->setClockSource(SERCOM_CLOCK_SOURCE_FCPU);
+  _spi->begin();
+}
+
+void V2Display::SPITransport::beginTransaction() {
+  // Needs SPIClass::setClockSource(SERCOM_CLOCK_SOURCE_FCPU) to work.
+  _spi->beginTransaction(SPISettings(60000000, MSBFIRST, SPI_MODE2));
+
+#ifdef ARDUINO_ARCH_SAMD
+  // A changed configuration initializes the SERCOM again; we never read
+  // anything back, disable the receiver.
+  if (_regs && _regs->SPI.CTRLB.bit.RXEN) {
+    _regs->SPI.CTRLB.bit.RXEN = 0;
+    while (_regs->SPI.SYNCBUSY.bit.CTRLB)
+      ;
+  }
+#endif
+
+  _output.cs.write(false);
+}
+
+void V2Display::SPITransport::endTransaction() {
+  while (_spi->isBusy())
+    yield();
+
+  drain();
+  _spi->endTransaction();
+  _output.cs.write(true);
+}
+
+bool V2Display::SPITransport::isBusy() {
+  return _spi->isBusy();
+}
+
+// Push a byte to the bus. With the receiver disabled, the data register is
+// written as soon as the previous byte has moved to the shift register.
+void V2Display::SPITransport::transmit(uint8_t b) {
+#ifdef ARDUINO_ARCH_SAMD
+  if (_regs) {
+    while (!_regs->SPI.INTFLAG.bit.DRE)
+      ;
+
+    _regs->SPI.DATA.reg = b;
+    _transmitting       = true;
+    return;
+  }
+#endif
+
+  _spi->transfer(b);
+}
+
+// Wait until the last byte has left the shift register, before the state of
+// the DC or CS pin is changed.
+void V2Display::SPITransport::drain() {
+  if (!_transmitting)
+    return;
+
+#ifdef ARDUINO_ARCH_SAMD
+  while (!_regs->SPI.INTFLAG.bit.TXC)
+    ;
+#endif
+
+  _transmitting = false;
+}
+
+void V2Display::SPITransport::write(const void *buffer, uint16_t len) {
+  while (_spi->isBusy())
+    yield();
+
+  const uint16_t *pixels = (const uint16_t *)buffer;
+  for (uint16_t i = 0; i < len / 2; i++) {
+    transmit(pixels[i] >> 8);
+    transmit(pixels[i] & 0xff);
+  }
+}
+
+void V2Display::SPITransport::writeCommand(uint8_t command, const uint8_t *data, uint8_t len) {
+  while (_spi->isBusy())
+    yield();
+
+  drain();
+  _output.dc.write(false);
+  transmit(command);
+  drain();
+  _output.dc.write(true);
+
+  for (uint8_t i = 0; i < len; i++)
+    transmit(data[i]);
+}
+
+void V2Display::SPI9BitTransport::begin() {
+  _output.cs.begin(_pin_cs, true);
+
+#ifdef ARDUINO_ARCH_SAMD
+  if (_sercom.sercom)
+    _regs = getRegisters(_sercom.sercom);
+
+  if (_regs) {
+    SPIClass *spi = beginSPI(_sercom.sercom, _sercom.pin.data, _sercom.pad_tx);
+    spi->beginTransaction(SPISettings(60000000, MSBFIRST, SPI_MODE2));
+    spi->endTransaction();
+
+    pinPeripheral(_sercom.pin.data, _sercom.pin_func);
+    pinPeripheral(_sercom.pin.clock, _sercom.pin_func);
+
+    // The character size can only be changed while the SERCOM is disabled.
+    _regs->SPI.CTRLA.bit.ENABLE = 0;
+    while (_regs->SPI.SYNCBUSY.bit.ENABLE)
+      ;
+
+    _regs->SPI.CTRLB.bit.CHSIZE = 1;
+    _regs->SPI.CTRLB.bit.RXEN   = 0;
+    _regs->SPI.CTRLA.bit.ENABLE = 1;
+    while (_regs->SPI.SYNCBUSY.bit.ENABLE)
+      ;
+
+    return;
+  }
+#endif
+
+  _output.data.begin(_sercom.pin.data, false);
+  _output.clock.begin(_sercom.pin.clock, false);
+}
+
+void V2Display::SPI9BitTransport::beginTransaction() {
+  _output.cs.write(false);
+}
+
+void V2Display::SPI9BitTransport::endTransaction() {
+  drain();
+  _output.cs.write(true);
+}
+
+void V2Display::SPI9BitTransport::transmit(bool data, uint8_t b) {
+  const uint16_t frame = (data ? 0x100 : 0) | b;
+
+#ifdef ARDUINO_ARCH_SAMD
+  if (_regs) {
+    while (!_regs->SPI.INTFLAG.bit.DRE)
+      ;
+
+    _regs->SPI.DATA.reg = frame;
+    return;
+  }
+#endif
+
+  // The controller samples the data with the rising edge of the clock.
+  for (int8_t i = 8; i >= 0; i--) {
+    _output.data.write(frame & (1 << i));
+    _output.clock.write(true);
+    _output.clock.write(false);
+  }
+}
+
+void V2Display::SPI9BitTransport::drain() {
+#ifdef ARDUINO_ARCH_SAMD
+  if (_regs)
+    while (!_regs->SPI.INTFLAG.bit.TXC)
+      ;
+#endif
+}
+
+void V2Display::SPI9BitTransport::write(const void *buffer, uint16_t len) {
+  const uint16_t *pixels = (const uint16_t *)buffer;
+  for (uint16_t i = 0; i < len / 2; i++) {
+    transmit(true, pixels[i] >> 8);
+    transmit(true, pixels[i] & 0xff);
+  }
+}
+
+void V2Display::SPI9BitTransport::writeCommand(uint8_t command, const uint8_t *data, uint8_t len) {
+  transmit(false, command);
+
+  for (uint8_t i = 0; i < len; i++)
+    transmit(true, data[i]);
+}
+
+void V2Display::ParallelTransport::begin() {
+  _output.wr.begin(_pin.wr, true);
+  _output.cs.begin(_pin.cs, true);
+  _output.dc.begin(_pin.dc, true);
+
+  for (uint8_t i = 0; i < 8; i++)
+    _output.data[i].begin(_pins_data[i], false);
+
+#ifdef ARDUINO_ARCH_SAMD
+  const PinDescription &d0 = g_APinDescription[_pins_data[0]];
+  if (d0.ulPin > 24)
+    return;
+
+  for (uint8_t i = 1; i < 8; i++) {
+    const PinDescription &d = g_APinDescription[_pins_data[i]];
+    if (d.ulPort != d0.ulPort || d.ulPin != d0.ulPin + i)
+      return;
+  }
+
+  PortGroup *group = &PORT->Group[d0.ulPort];
+  _port.set        = &group->OUTSET.reg;
+  _port.clear      = &group->OUTCLR.reg;
+  _port.shift      = d0.ulPin;
+#endif
+}
+
+void V2Display::ParallelTransport::beginTransaction() {
+  _output.cs.write(false);
+}
+
+void V2Display::ParallelTransport::endTransaction() {
+  _output.cs.write(true);
+}
+
+void V2Display::ParallelTransport::transmit(uint8_t b) {
+#ifdef ARDUINO_ARCH_SAMD
+  if (_port.set) {
+    *_port.clear = (uint32_t)(~b & 0xff) << _port.shift;
+    *_port.set   = (uint32_t)b << _port.shift;
+    _output.wr.write(false);
+    _output.wr.write(true);
+    return;
+  }
+#endif
+
+  for (uint8_t i = 0; i < 8; i++)
+    _output.data[i].write(b & (1 << i));
+
+  _output.wr.write(false);
+  _output.wr.write(true);
+}
+
+void V2Display::ParallelTransport::write(const void *buffer, uint16_t len) {
+  const uint16_t *pixels = (const uint16_t *)buffer;
+  for (uint16_t i = 0; i < len / 2; i++) {
+    transmit(pixels[i] >> 8);
+    transmit(pixels[i] & 0xff);
+  }
+}
+
+void V2Display::ParallelTransport::writeCommand(uint8_t command, const uint8_t *data, uint8_t len) {
+  _output.dc.write(false);
+  transmit(command);
+  _output.dc.write(true);
+
+  for (uint8_t i = 0; i < len; i++)
+    transmit(data[i]);
+}
+
+enum {
+  DCS_CASET = 0x2a,
+  DCS_RASET = 0x2b,
+  DCS_RAMWR = 0x2c,
+};
+
+void V2Display::SimulatorTransport::writeCommand(uint8_t command, const uint8_t *data, uint8_t len) {
+  _bytes += 1 + len;
+  _command = command;
+
+  switch (command) {
+    case DCS_CASET:
+      if (len < 4)
+        break;
+
+      _column.start = (data[0] << 8) | data[1];
+      _column.end   = (data[2] << 8) | data[3];
+      break;
+
+    case DCS_RASET:
+      if (len < 4)
+        break;
+
+      _row.start = (data[0] << 8) | data[1];
+      _row.end   = (data[2] << 8) | data[3];
+      break;
+
+    case DCS_RAMWR:
+      _cursor.x = _column.start;
+      _cursor.y = _row.start;
+      break;
+  }
+}
+
+void V2Display::SimulatorTransport::write(const void *buffer, uint16_t len) {
+  _bytes += len;
+  if (_command != DCS_RAMWR)
+    return;
+
+  const uint16_t *pixels = (const uint16_t *)buffer;
+  for (uint16_t i = 0; i < len / 2; i++) {
+    if (_cursor.x < _width && _cursor.y < _height && _cursor.y <= _row.end)
+      _pixels[(_cursor.y * _width) + _cursor.x] = pixels[i];
+
+    if (++_cursor.x > _column.end) {
+      _cursor.x = _column.start;
+      _cursor.y++;
+    }
+  }
+}
@@ -3,51 +3,33 @@
 
 #include "V2Display.h"
 #include "font/Font.h"
+#include <V2Base.h>
 #include <limits.h>
-#include <wiring_private.h>
 
-void V2Display::Display::begin() {
-  _buffer = (uint16_t *)malloc(_hardware.width * row_size * sizeof(uint16_t));
+bool V2Display::Display::begin() {
+  if (!_buffer)
+    _buffer = (uint16_t *)malloc(_buffer_width * row_size * sizeof(uint16_t));
 
-  // Build SPI bus from SERCOM.
-  //
-  // SPIClass.begin() applies the board config to all given pins, which might not
-  // match our configuration. Just pass the same pin to all of them, to make sure
-  // we do not touch anything else. Our pin will be switched to the SERCOM after
-  // begin().
-  if (!_spi)
-    _spi = new SPIClass(_sercom.sercom,
-                        _sercom.pin.data,
-                        _sercom.pin.data,
-                        _sercom.pin.data,
-                        _sercom.pad_tx,
-                        SERCOM_RX_PAD_3);
+  if (!_buffer)
+    return false;
 
-  // Use faster clock, the transaction requests 60 Mhz.
-  _spi->setClockSource(SERCOM_CLOCK_SOURCE_FCPU);
-
-  _spi->begin();
-
-  if (_sercom.sercom) {
-    pinPeripheral(_sercom.pin.data, _sercom.pin_func);
-    pinPeripheral(_sercom.pin.clock, _sercom.pin_func);
-  }
+  _reset.begin(_pin.reset, true);
+  _transport->begin();
+  return true;
 }
 
 void V2Display::Display::reset(uint16_t orientation, uint16_t color) {
-  pinMode(_pin.cs, OUTPUT);
-  digitalWrite(_pin.cs, LOW);
-
-  pinMode(_pin.dc, OUTPUT);
-  digitalWrite(_pin.dc, HIGH);
-
-  pinMode(_pin.reset, OUTPUT);
-  digitalWrite(_pin.reset, LOW);
+  _reset.write(false);
   delay(1);
-  digitalWrite(_pin.reset, HIGH);
+  _reset.write(true);
   delay(5);
 
-  _busy = false;
+  // Abandon the running job.
+  _busy              = false;
+  _slicing.remaining = 0;
+  _slicing.count     = 0;
+  _slicing.area      = NULL;
+  _epoch++;
   prepareWrite();
   writeReset();
   writeSetOrientation(orientation);
@@ -55,55 +37,430 @@ void V2Display::Display::reset(uint16_t orientation, uint16_t color) {
   finishWrite();
 }
 
-void V2Display::Display::loop() {
+// Finish the running job when the transfer is complete. Returns true if the
+// display is idle.
+bool V2Display::Display::poll() {
   if (!_busy)
-    return;
+    return true;
 
-  if (_spi->isBusy())
-    return;
+  if (_transport->isBusy())
+    return false;
+
+  if (isSliced()) {
+    writeSlice();
+    return false;
+  }
 
   finishWrite();
   _busy = false;
+  _completion.count++;
+  return true;
 }
 
-void V2Display::Display::prepareWrite() {
-  while (_busy) {
+// Block until the running job has finished.
+void V2Display::Display::wait() {
+  while (!poll()) {
+#if __has_include(<FreeRTOS.h>)
+    // Sleep while the transfer is running, until its completion is notified or
+    // the next tick.
+    if (_task.handle && xTaskGetCurrentTaskHandle() == _task.handle) {
+      if (_transport->isBusy())
+        ulTaskNotifyTake(pdTRUE, 1);
+
+      continue;
+    }
+#endif
+
     yield();
-    loop();
+  }
+}
+
+void V2Display::Display::loop() {
+  receive();
+  dispatch();
+  report();
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+  resume();
+#endif
+}
+
+// Call the handler once for every completed job. Jobs which complete while the
+// handler runs are reported with the next call.
+void V2Display::Display::report() {
+  const uint32_t count = _completion.count;
+  while (_completion.reported != count) {
+    _completion.reported++;
+    if (_completion.handler)
+      _completion.handler(_completion.context);
+  }
+}
+
+// Finish the running job and start the next one.
+void V2Display::Display::dispatch() {
+  if (!poll())
+    return;
+
+  // The offscreen buffer contains characters from drawChar().
+  if (_drawing)
+    return;
+
+  if (!hasCredit())
+    return;
+
+  TextArea *area = dequeue();
+  if (!area)
+    return;
+
+  // Rendering the text or the marquee applies the current highlight.
+  if (area->_pending.print) {
+    area->_pending.print     = false;
+    area->_pending.highlight = false;
+    area->_pending.restyle   = false;
+    renderText(area, area->_pending.text[0] == '\0' ? NULL : area->_pending.text);
+
+    // Scrolling the new text is a separate job.
+    if (area->_pending.scroll > 0)
+      enqueue(area);
+
+  } else if (area->_pending.scroll > 0) {
+    const uint16_t columns   = area->_pending.scroll;
+    area->_pending.scroll    = 0;
+    area->_pending.highlight = false;
+    area->_pending.restyle   = false;
+    renderScroll(area, columns);
+
+  } else if (area->_pending.restyle) {
+    area->_pending.restyle   = false;
+    area->_pending.highlight = false;
+    renderAgain(area);
+
+  } else if (area->_pending.highlight) {
+    area->_pending.highlight = false;
+    renderHighlight(area);
+  }
+
+  // The number of the started job, or of the last finished one if nothing
+  // needed to be sent.
+  area->_job = _completion.count + (_busy ? 1 : 0);
+}
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+void V2Display::Awaitable::await_suspend(std::coroutine_handle<> handle) {
+  _handle = handle;
+  _next   = NULL;
+
+  if (_display->_waiters.last)
+    _display->_waiters.last->_next = this;
+
+  else
+    _display->_waiters.first = this;
+
+  _display->_waiters.last = this;
+}
+
+bool V2Display::FlushAwaitable::step() {
+  return !_display->_busy && !_display->isQueued();
+}
+
+bool V2Display::PrintAwaitable::step() {
+  return !_area->isPending() && _display->isCompleted(_area->_job);
+}
+
+bool V2Display::FillAwaitable::step() {
+  if (!_started) {
+    if (_display->_busy || _display->_drawing)
+      return false;
+
+    _display->fillRectangle(_rectangle.x, _rectangle.y, _rectangle.width, _rectangle.height, _rectangle.color);
+    _started = true;
+    _job     = _display->_completion.count + 1;
+  }
+
+  return _display->isCompleted(_job);
+}
+
+// Resume the coroutines whose awaited operation is complete. A resumed coroutine
+// might wait again, or destroy its awaitable; the list is detached first.
+void V2Display::Display::resume() {
+  Awaitable *waiter = _waiters.first;
+  _waiters.first    = NULL;
+  _waiters.last     = NULL;
+
+  while (waiter) {
+    Awaitable *next = waiter->_next;
+
+    if (waiter->step())
+      waiter->_handle.resume();
+
+    else {
+      waiter->_next = NULL;
+      if (_waiters.last)
+        _waiters.last->_next = waiter;
+
+      else
+        _waiters.first = waiter;
+
+      _waiters.last = waiter;
+    }
+
+    waiter = next;
+  }
+}
+#endif
+
+#if __has_include(<FreeRTOS.h>)
+bool V2Display::Display::beginTask(UBaseType_t priority, uint16_t stack_size, uint8_t queue_length) {
+  _task.queue = xQueueCreate(queue_length, sizeof(Request));
+  if (!_task.queue)
+    return false;
+
+  if (xTaskCreate(runTask, "V2Display", stack_size, this, priority, &_task.handle) != pdPASS) {
+    vQueueDelete(_task.queue);
+    _task.queue = NULL;
+    return false;
+  }
+
+  return true;
+}
+
+void V2Display::Display::runTask(void *display) {
+  Display *d = (Display *)display;
+
+  for (;;) {
+    Request request;
+    while (xQueueReceive(d->_task.queue, &request, 0) == pdTRUE) {
+      request.area->setText(request.text[0] == '\0' ? NULL : request.text);
+      d->enqueue(request.area);
+    }
+
+    d->loop();
+
+    // Continue without sleeping if the running job can make progress, or if
+    // requests are waiting.
+    if (d->_busy && !d->_transport->isBusy())
+      continue;
+
+    if (uxQueueMessagesWaiting(d->_task.queue) > 0 || d->_ring.tail.load() != d->_ring.head.load())
+      continue;
+
+    // Sleep while a transfer is running or queued jobs are held back, until a
+    // notification or the next tick. Otherwise sleep until a request arrives.
+    const bool idle = !d->_busy && !d->isQueued();
+    ulTaskNotifyTake(pdTRUE, idle ? portMAX_DELAY : 1);
+  }
+}
+
+bool V2Display::Display::send(TextArea *area, const char s[], TickType_t timeout) {
+  if (!_task.queue)
+    return false;
+
+  Request request{.area{area}};
+  if (s) {
+    strncpy(request.text, s, sizeof(request.text) - 1);
+    request.text[sizeof(request.text) - 1] = '\0';
+  }
+
+  if (xQueueSend(_task.queue, &request, timeout) != pdTRUE)
+    return false;
+
+  xTaskNotifyGive(_task.handle);
+  return true;
+}
+
+void V2Display::Display::notifyFromISR() {
+  if (!_task.handle)
+    return;
+
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(_task.handle, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+#endif
+
+void V2Display::Display::enqueue(TextArea *area) {
+  if (area->_queued)
+    return;
+
+  auto &queue = _queue[area->_priority];
+  if (queue.last)
+    queue.last->_next = area;
+
+  else
+    queue.first = area;
+
+  queue.last         = area;
+  area->_queued      = true;
+  area->_queued_usec = micros();
+}
+
+// Remove the first area of the highest priority queue. Areas which print faster
+// than their maximum rate stay in the queue.
+V2Display::TextArea *V2Display::Display::dequeue() {
+  const uint32_t now = micros();
+
+  for (int8_t p = PriorityCount - 1; p >= 0; p--) {
+    auto &queue    = _queue[p];
+    TextArea *prev = NULL;
+    TextArea *area = queue.first;
+    while (area && isThrottled(area, now)) {
+      prev = area;
+      area = area->_next;
+    }
+
+    if (!area)
+      continue;
+
+    if (prev)
+      prev->_next = area->_next;
+
+    else
+      queue.first = area->_next;
+
+    if (queue.last == area)
+      queue.last = prev;
+
+    if (area->_pending.print)
+      area->_throttle.printed_usec = now;
+
+    area->_next   = NULL;
+    area->_queued = false;
+
+    const uint32_t usec = now - area->_queued_usec;
+    _latency[p].jobs++;
+    _latency[p].total_usec += usec;
+    if (usec > _latency[p].max_usec)
+      _latency[p].max_usec = usec;
+
+    return area;
   }
 
-  // Needs SPIClass::setClockSource(SERCOM_CLOCK_SOURCE_FCPU) to work.
-  _spi->beginTransaction(SPISettings(60000000, MSBFIRST, SPI_MODE2));
-  digitalWrite(_pin.cs, LOW);
+  return NULL;
+}
+
+// The area prints faster than its maximum rate.
+bool V2Display::Display::isThrottled(const TextArea *area, uint32_t now) const {
+  return area->_pending.print && area->_throttle.interval_usec > 0 &&
+         now - area->_throttle.printed_usec < area->_throttle.interval_usec;
+}
+
+// A queued area can be rendered now.
+bool V2Display::Display::isDue() const {
+  const uint32_t now = micros();
+
+  for (uint8_t p = 0; p < PriorityCount; p++)
+    for (TextArea *area = _queue[p].first; area; area = area->_next)
+      if (!isThrottled(area, now))
+        return true;
+
+  return false;
+}
+
+bool V2Display::Display::isQueued() const {
+  for (uint8_t p = 0; p < PriorityCount; p++)
+    if (_queue[p].first)
+      return true;
+
+  return false;
+}
+
+// Add the area to the queue, and render it if the display is idle.
+void V2Display::Display::submit(TextArea *area) {
+  enqueue(area);
+  dispatch();
+}
+
+void V2Display::Display::prepareWrite() {
+  wait();
+  _transport->beginTransaction();
 }
 
 void V2Display::Display::write(const void *buffer, uint16_t len) {
-  while (_spi->isBusy())
-    yield();
+  _transport->write(buffer, len);
 
-  //_spi->transfer(buffer, NULL, len, false);
-  for (uint16_t i = 0; i < len; i++)
-    _spi->transfer(((uint8_t *)buffer)[i]);
+  if (_frame.period_usec > 0)
+    _frame.credit -= len;
 }
 
-void V2Display::Display::finishWrite() {
-  while (_spi->isBusy())
-    yield();
+// Refill the budget for every elapsed frame. Returns false if jobs need to wait
+// for the next frame.
+bool V2Display::Display::hasCredit() {
+  if (_frame.period_usec == 0)
+    return true;
+
+  const uint32_t frames = (micros() - _frame.start_usec) / _frame.period_usec;
+  if (frames > 0) {
+    _frame.start_usec += frames * _frame.period_usec;
+    _frame.credit = min((int64_t)_frame.credit + (int64_t)frames * _frame.budget, (int64_t)_frame.budget);
+    _frame.deferred = false;
+  }
+
+  if (_frame.credit > 0)
+    return true;
+
+  // Count the frame once, if it holds back a job which could be rendered.
+  if (!_frame.deferred && isDue()) {
+    _frame.deferred = true;
+    _slicing.stats.deferred++;
+  }
+
+  return false;
+}
 
-  _spi->endTransaction();
-  digitalWrite(_pin.cs, HIGH);
+void V2Display::Display::finishWrite() {
+  _transport->endTransaction();
 }
 
 void V2Display::Display::writeCommand(uint8_t command, const uint8_t *data, uint8_t len) {
-  while (_spi->isBusy())
-    yield();
+  _transport->writeCommand(command, data, len);
+}
 
-  digitalWrite(_pin.dc, LOW);
-  _spi->transfer(command);
-  digitalWrite(_pin.dc, HIGH);
+// Fill pixels with a color, two pixels per 32 bit store.
+static void fillPixels(uint16_t *pixels, uint16_t color, uint32_t count) {
+  if (count > 0 && ((uintptr_t)pixels & 2)) {
+    *pixels++ = color;
+    count--;
+  }
 
-  for (uint8_t i = 0; i < len; i++)
-    _spi->transfer(data[i]);
+  typedef uint32_t __attribute__((may_alias)) word;
+  word *words         = (word *)pixels;
+  const uint32_t pair = (color << 16) | color;
+  for (uint32_t i = 0; i < count / 2; i++)
+    words[i] = pair;
+
+  if (count & 1)
+    pixels[count - 1] = color;
+}
+
+void V2Display::Gamma::set(float gamma, float brightness) {
+  brightness = constrain(brightness, 0.f, 1.f);
+
+  for (uint8_t i = 0; i < 32; i++) {
+    _red[i]  = lroundf(powf(i / 31.f, gamma) * brightness * 31);
+    _blue[i] = _red[i];
+  }
+
+  for (uint8_t i = 0; i < 64; i++)
+    _green[i] = lroundf(powf(i / 63.f, gamma) * brightness * 63);
+}
+
+// Composite two pixels per 32 bit load and store.
+void V2Display::Blend::apply(uint16_t *pixels, uint32_t count) const {
+  if (count > 0 && ((uintptr_t)pixels & 2)) {
+    *pixels = apply(*pixels);
+    pixels++;
+    count--;
+  }
+
+  typedef uint32_t __attribute__((may_alias)) word;
+  word *words = (word *)pixels;
+  for (uint32_t i = 0; i < count / 2; i++) {
+    const uint32_t pair = words[i];
+    words[i]            = (apply(pair >> 16) << 16) | apply(pair & 0xffff);
+  }
+
+  if (count & 1)
+    pixels[count - 1] = apply(pixels[count - 1]);
 }
 
 // 240 * 240 * 16bit = 921600 bits
@@ -113,9 +470,17 @@ void V2Display::Display::writeFillRectangle(uint16_t x, uint16_t y, uint16_t wid
 
   // Write rows of pixels. Return when the last row is offloaded to the DMA engine.
   uint32_t n_pixels = width * height;
-  uint32_t len      = min(n_pixels, _hardware.width * row_size);
-  for (uint16_t i = 0; i < len; i++)
-    _buffer[i] = __builtin_bswap16(color);
+  uint32_t len      = min(n_pixels, _buffer_width * row_size);
+  fillPixels(_buffer, dim(color), len);
+
+  _resident = NULL;
+
+  // The covered areas do not show their text anymore.
+  for (TextArea *area = _areas; area; area = area->_link) {
+    const uint16_t top = area->_row * row_size;
+    if (x < area->_x + area->_width && area->_x < x + width && y < top + row_size && top < y + height)
+      area->_rendered.epoch = 0;
+  }
 
   while (n_pixels > 0) {
     const uint16_t count = min(n_pixels, len);
@@ -125,51 +490,170 @@ void V2Display::Display::writeFillRectangle(uint16_t x, uint16_t y, uint16_t wid
 }
 
 void V2Display::Display::fillRectangle(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t color) {
-  while (_busy) {
-    yield();
-    loop();
-  }
-
   prepareWrite();
   writeFillRectangle(x, y, width, height, color);
   _busy = true;
 }
 
+static uint16_t interpolate(int16_t from, int16_t to, uint8_t n, uint8_t d) {
+  return from + (((to - from) * n) / d);
+}
+
+// The background color of a scanline of the text row.
+uint16_t V2Display::TextArea::getBackground(uint8_t y) const {
+  switch (_shading.shading) {
+    case Flat:
+      break;
+
+    case Gradient: {
+      // Interpolate the 5:6:5 channels separately.
+      const uint16_t top    = _background;
+      const uint16_t bottom = _shading.color;
+      const uint16_t r      = interpolate(top >> 11, bottom >> 11, y, Display::row_size - 1);
+      const uint16_t g      = interpolate((top >> 5) & 0x3f, (bottom >> 5) & 0x3f, y, Display::row_size - 1);
+      const uint16_t b      = interpolate(top & 0x1f, bottom & 0x1f, y, Display::row_size - 1);
+      return (r << 11) | (g << 5) | b;
+    }
+
+    case Stripes:
+      if ((y / _shading.height) & 1)
+        return _shading.color;
+      break;
+  }
+
+  return _background;
+}
+
+// Extend the range of scanlines by the glyph of the character.
+static void addBounds(const Font *font, char c, uint8_t &top, uint8_t &bottom) {
+  const Font::Glyph *glyph = font->getGlyph(c);
+  if (glyph->height == 0)
+    return;
+
+  const int16_t start = V2Display::Display::baseline + glyph->yStart;
+  const int16_t end   = start + glyph->height;
+  top                 = min(top, (uint8_t)constrain(start, 0, V2Display::Display::row_size));
+  bottom              = max(bottom, (uint8_t)constrain(end, 0, V2Display::Display::row_size));
+}
+
 // Initialize offscreen buffer with background color.
-void V2Display::Display::initializeBuffer() {
+void V2Display::Display::initializeBuffer(TextArea *area) {
   for (uint16_t y = 0; y < row_size; y++)
-    for (uint16_t x = 0; x < _area.width; x++)
-      _buffer[(y * _area.width) + x] = __builtin_bswap16(_area.background);
+    fillPixels(_buffer + (y * area->_width), getBackground(area, y), area->_width);
+
+  _resident            = NULL;
+  area->_rendered.font = NULL;
+}
+
+// Initialize a range of columns of the offscreen buffer with background color.
+void V2Display::Display::initializeColumns(TextArea *area, uint16_t start, uint16_t end) {
+  for (uint16_t y = 0; y < row_size; y++)
+    fillPixels(_buffer + (y * area->_width) + start, getBackground(area, y), end - start);
 }
 
-// Offload the writing of the buffer to the DMA engine.
-void V2Display::Display::flushBuffer() {
+// Offload the writing of the offscreen buffer, or the given range of its
+// scanlines; loop() sends the remaining slices. With render, the shown text of
+// the area is rendered scanline by scanline, just before it is sent.
+void V2Display::Display::flushBuffer(TextArea *area, uint8_t top, uint8_t bottom, bool render) {
   prepareWrite();
-  writeSetWindow(_area.x, _area.row * row_size, _area.width, row_size);
-  write(_buffer, _area.width * row_size * sizeof(uint16_t));
+  writeSetWindow(area->_x, (area->_row * row_size) + top, area->_width, bottom - top);
+  _slicing.pixels    = _buffer + (top * area->_width);
+  _slicing.remaining = area->_width * (bottom - top);
+  _slicing.scanline  = area->_width;
+  _slicing.count     = 0;
+  _slicing.area      = render ? area : NULL;
+
+  // Copy the style, the area might change it while its text is sent.
+  if (render) {
+    _slicing.font       = area->_rendered.font;
+    _slicing.blend      = area->_highlight.shown;
+    _slicing.tabular    = area->_tabular;
+    _slicing.foreground = getForeground(area);
+    for (uint8_t y = 0; y < row_size; y++)
+      _slicing.background[y] = getBackground(area, y);
+
+    _slicing.top      = top;
+    _slicing.bottom   = bottom;
+    _slicing.rendered = 0;
+  }
+
   _busy = true;
+  writeSlice();
 }
 
-static uint16_t renderChar(uint16_t *buffer,
-                           const Font *font,
-                           uint8_t width,
-                           uint16_t x,
-                           uint16_t y,
-                           uint8_t c,
-                           uint16_t color) {
+// Send scanlines of the offscreen buffer until the time budget is used up, at
+// least one scanline per call. A rendered text is rendered scanline by scanline,
+// the scanlines outside of the sent range complete the offscreen buffer.
+void V2Display::Display::writeSlice() {
+  const uint32_t start = micros();
+
+  do {
+    if (_slicing.area) {
+      const uint8_t y = _slicing.rendered++;
+      renderScanline(y);
+      if (_slicing.rendered == row_size)
+        _slicing.area = NULL;
+
+      if (y < _slicing.top || y >= _slicing.bottom)
+        continue;
+    }
+
+    write(_slicing.pixels, _slicing.scanline * sizeof(uint16_t));
+    _slicing.pixels += _slicing.scanline;
+    _slicing.remaining -= _slicing.scanline;
+  } while (isSliced() && (_slicing.budget == 0 || micros() - start < _slicing.budget));
+
+  _slicing.count++;
+  if (isSliced())
+    return;
+
+  _slicing.stats.jobs++;
+  _slicing.stats.slices += _slicing.count;
+  if (_slicing.count > _slicing.stats.max_slices)
+    _slicing.stats.max_slices = _slicing.count;
+}
+
+// Render a glyph, pixels outside of the columns clip_start..clip_end and the
+// scanlines clip_top..clip_bottom are skipped.
+uint16_t V2Display::Display::renderChar(uint16_t *buffer,
+                                        const Font *font,
+                                        uint16_t width,
+                                        int16_t x,
+                                        uint16_t y,
+                                        uint8_t c,
+                                        uint16_t color,
+                                        uint16_t clip_start,
+                                        uint16_t clip_end,
+                                        uint16_t clip_top,
+                                        uint16_t clip_bottom) {
   const Font::Glyph *glyph = font->getGlyph(c);
-  uint16_t o               = glyph->offset;
-  uint8_t map              = 0;
-  uint8_t bit              = 0;
-  for (uint8_t iy = 0; iy < glyph->height; iy++) {
+  const int16_t left       = x + glyph->xStart;
+  if (left >= clip_end || left + glyph->width <= clip_start)
+    return glyph->advance;
+
+  // The rows of the glyph inside the scanlines clip_top..clip_bottom.
+  const int16_t top   = y + glyph->yStart;
+  const int16_t first = max(0, clip_top - top);
+  const int16_t last  = min((int16_t)glyph->height, (int16_t)(clip_bottom - top));
+  if (first >= last)
+    return glyph->advance;
+
+  // Skip the bits of the rows above.
+  const uint16_t skip = first * glyph->width;
+  uint16_t o          = glyph->offset + (skip / 8);
+  uint8_t bit         = skip & 0x07;
+  uint8_t map         = bit > 0 ? font->bitmaps[o++] << bit : 0;
+  for (uint8_t iy = first; iy < last; iy++) {
     for (uint8_t ix = 0; ix < glyph->width; ix++) {
       if (!(bit++ & 0x07))
         map = font->bitmaps[o++];
 
       if (map & 0x80) {
-        const uint16_t bx         = x + glyph->xStart + ix;
-        const uint16_t by         = y + glyph->yStart + iy;
-        buffer[(width * by) + bx] = __builtin_bswap16(color);
+        const int16_t bx = left + ix;
+        if (bx >= clip_start && bx < clip_end) {
+          const uint16_t by         = y + glyph->yStart + iy;
+          buffer[(width * by) + bx] = color;
+        }
       }
       map <<= 1;
     }
@@ -178,20 +662,125 @@ static uint16_t renderChar(uint16_t *buffer,
   return glyph->advance;
 }
 
-void V2Display::Display::drawChar(char c) {
-  while (_busy) {
-    yield();
-    loop();
+static bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// The cell of a tabular digit; wide enough for the advance and the pixels of
+// every digit.
+static uint8_t getDigitAdvance(const Font *font) {
+  uint8_t advance = 0;
+  for (char c = '0'; c <= '9'; c++) {
+    const Font::Glyph *glyph = font->getGlyph(c);
+    advance                  = max(advance, max(glyph->advance, glyph->width));
   }
 
-  if (_area.cursor == 0)
-    initializeBuffer();
+  return advance;
+}
+
+// The pixels of the glyph do not reach beyond its advance.
+static bool isContained(const Font *font, char c) {
+  const Font::Glyph *glyph = font->getGlyph(c);
+  return glyph->xStart >= 0 && glyph->xStart + glyph->width <= glyph->advance;
+}
+
+static uint8_t getAdvance(const Font *font, char c, bool tabular) {
+  if (tabular && isDigit(c))
+    return getDigitAdvance(font);
 
-  _area.cursor += renderChar(_buffer, &fontDefault, _area.width, _area.cursor, baseline, c, _area.foreground);
+  return font->getGlyph(c)->advance;
+}
+
+// Render a character at the cursor position. In tabular mode, the pixels of
+// digits are centered in a cell of uniform width. Returns the advance.
+uint16_t V2Display::Display::renderCell(uint16_t *buffer,
+                                        const Font *font,
+                                        uint16_t width,
+                                        int16_t x,
+                                        uint8_t c,
+                                        uint16_t color,
+                                        uint16_t clip_start,
+                                        uint16_t clip_end,
+                                        bool tabular,
+                                        uint16_t clip_top,
+                                        uint16_t clip_bottom) {
+  const uint8_t advance = getAdvance(font, c, tabular);
+  if (tabular && isDigit(c)) {
+    const Font::Glyph *glyph = font->getGlyph(c);
+    x += ((advance - glyph->width) / 2) - glyph->xStart;
+  }
+
+  renderChar(buffer, font, width, x, baseline, c, color, clip_start, clip_end, clip_top, clip_bottom);
+  return advance;
+}
+
+// Render a scanline of the text which is sent.
+void V2Display::Display::renderScanline(uint8_t y) {
+  const TextArea *area = _slicing.area;
+  const uint16_t width = _slicing.scanline;
+  uint16_t *line       = _buffer + (y * width);
+  fillPixels(line, _slicing.background[y], width);
+
+  uint16_t cursor = area->_rendered.start;
+  for (uint8_t i = 0; i < area->_rendered.len; i++) {
+    const char c           = area->_rendered.text[i];
+    const uint16_t advance = getAdvance(_slicing.font, c, _slicing.tabular);
+    if (cursor + advance > width)
+      break;
+
+    renderCell(_buffer, _slicing.font, width, cursor, c, _slicing.foreground, 0, width, _slicing.tabular, y, y + 1);
+    cursor += advance;
+  }
+
+  if (_slicing.blend)
+    _slicing.blend->apply(line, width);
+}
+
+// Render the remaining scanlines of the text, the slices send them from the
+// offscreen buffer.
+void V2Display::Display::completeBuffer() {
+  if (!_slicing.area)
+    return;
+
+  while (_slicing.rendered < row_size)
+    renderScanline(_slicing.rendered++);
+
+  _slicing.area = NULL;
+}
+
+static const Font *const defaultFonts[]{&fontDefault, &fontCondensed, &fontCondensedSmall};
+
+const Font *const *V2Display::TextArea::getFonts() const {
+  if (_fonts.pinned)
+    return &_fonts.pinned;
+
+  return _fonts.count > 0 ? _fonts.list : defaultFonts;
+}
+
+uint8_t V2Display::TextArea::getFontsCount() const {
+  if (_fonts.pinned)
+    return 1;
+
+  return _fonts.count > 0 ? _fonts.count : V2Base::countof(defaultFonts);
+}
+
+void V2Display::Display::drawChar(char c) {
+  wait();
+
+  // The offscreen buffer might have been used by a text area since the last call.
+  _area._marquee.len = 0;
+  if (_area._cursor == 0 || _resident != &_area)
+    initializeBuffer(&_area);
+
+  _resident = &_area;
+  _drawing  = true;
+  _area._cursor += renderChar(
+    _buffer, _area.getFonts()[0], _area._width, _area._cursor, baseline, c, getForeground(&_area), 0, _area._width);
 }
 
 // Calculate the width of the printed string.
-static uint16_t getTextWidth(const char *s, uint8_t len, const Font *font, char text[32], uint8_t &textLen) {
+static uint16_t
+getTextWidth(const char *s, uint8_t len, const Font *font, bool tabular, char text[32], uint8_t &textLen) {
   uint16_t width = 0;
   bool replaced{};
   textLen = 0;
@@ -216,26 +805,62 @@ static uint16_t getTextWidth(const char *s, uint8_t len, const Font *font, char
       replaced = false;
 
     text[textLen++] = c;
-    width += font->getGlyph(c)->advance;
+    width += getAdvance(font, c, tabular);
   }
 
   return width;
 }
 
+// The marquee repeats the text, separated by an empty gap.
+static constexpr uint16_t marquee_gap = V2Display::Display::row_size / 2;
+
+// Shorten the text until it fits, including the appended "...". Returns the new width.
+static uint16_t
+truncateText(const Font *font, bool tabular, uint16_t width, char *text, uint8_t &textLen, uint16_t textWidth) {
+  const uint8_t dot = font->getGlyph('.')->advance;
+  while (textLen > 0 && textWidth + (3 * dot) > width)
+    textWidth -= getAdvance(font, text[--textLen], tabular);
+
+  // Do not separate the ellipsis from the text.
+  while (textLen > 0 && text[textLen - 1] == ' ')
+    textWidth -= getAdvance(font, text[--textLen], tabular);
+
+  for (uint8_t i = 0; i < 3; i++) {
+    text[textLen++] = '.';
+    textWidth += dot;
+  }
+
+  return textWidth;
+}
+
 // 135 * 60 * 16bit = 129600 bits
 // 129600 bits / 60Mhz = 2.16 ms
-void V2Display::Display::print(const char s[]) {
-  while (_busy) {
-    yield();
-    loop();
+void V2Display::Display::renderText(TextArea *area, const char s[]) {
+  area->_marquee.len = 0;
+  _drawing           = false;
+
+  // Remember the text, to render it again with a different highlight.
+  if (s != area->_pending.text)
+    area->_pending.text[0] = '\0';
+
+  if (s && s != area->_pending.text) {
+    strncpy(area->_pending.text, s, sizeof(area->_pending.text) - 1);
+    area->_pending.text[sizeof(area->_pending.text) - 1] = '\0';
   }
 
   if (!s) {
+    area->_rendered.font = NULL;
+
     // Do not clear the buffer if drawChar() rendered characters.
-    if (_area.cursor == 0)
-      initializeBuffer();
+    if (area->_cursor > 0) {
+      flushBuffer(area);
+      return;
+    }
 
-    flushBuffer();
+    area->_rendered.len    = 0;
+    area->_highlight.shown = area->_highlight.blend;
+    _resident              = area;
+    flushBuffer(area, 0, row_size, true);
     return;
   }
 
@@ -247,62 +872,605 @@ void V2Display::Display::print(const char s[]) {
     len = 32;
 
   // Ignore trailing whitespace.
-  while (s[len - 1] == ' ')
+  while (len > 0 && s[len - 1] == ' ')
     len--;
 
-  // Calculate the width of the printed string.
-  const Font *font = &fontDefault;
-  char text[32];
-  uint8_t textLen;
-  uint16_t textWidth = getTextWidth(s, len, &fontDefault, text, textLen);
-
-  // Use the condensed font if the text does not fit into the area.
-  if (textWidth > _area.width) {
-    font      = &fontCondensed;
-    textWidth = getTextWidth(s, len, font, text, textLen);
+  // Calculate the width of the printed string, leave room for the ellipsis. Use
+  // the next, narrower font if the text does not fit into the area.
+  const Font *const *fonts = area->getFonts();
+  const Font *font{};
+  char text[32 + 3];
+  uint8_t textLen{};
+  uint16_t textWidth{};
+  for (uint8_t i = 0; i < area->getFontsCount(); i++) {
+    font      = fonts[i];
+    textWidth = getTextWidth(s, len, font, area->_tabular, text, textLen);
+    if (textWidth <= area->_width)
+      break;
   }
 
-  // Use the smaller font if the text does not fit into the area.
-  if (textWidth > _area.width) {
-    font      = &fontCondensedSmall;
-    textWidth = getTextWidth(s, len, font, text, textLen);
-  }
+  if (textWidth > area->_width) {
+    switch (area->_overflow) {
+      case Clip:
+        textWidth = area->_width;
+        break;
+
+      case Ellipsis:
+        textWidth = truncateText(font, area->_tabular, area->_width, text, textLen, textWidth);
+        break;
 
-  if (textWidth > _area.width)
-    textWidth = _area.width;
+      case Marquee:
+        memcpy(area->_marquee.text, text, textLen);
+        area->_marquee.len    = textLen;
+        area->_marquee.font   = font;
+        area->_marquee.period = textWidth + marquee_gap;
+        area->_marquee.offset = 0;
+        area->_cursor         = 0;
+        area->_rendered.epoch = _epoch;
 
-  switch (_area.justify) {
+        initializeBuffer(area);
+        renderMarquee(area, 0, area->_width);
+        flushBuffer(area);
+        return;
+    }
+  }
+
+  uint16_t cursor = 0;
+  switch (area->_justify) {
     case Left:
-      _area.cursor = 0;
       break;
 
     case Center:
-      _area.cursor = (_area.width - textWidth) / 2;
+      cursor = (area->_width - textWidth) / 2;
       break;
 
     case Right:
-      _area.cursor = _area.width - textWidth;
+      cursor = area->_width - textWidth;
       break;
   }
 
-  initializeBuffer();
+  area->_cursor = 0;
+  if (updateDigits(area, font, text, textLen, cursor))
+    return;
 
-  // Render text.
+  // The screen shows the previous text of this area over the same background;
+  // only the scanlines covered by the old or the new glyphs need to be sent.
+  uint8_t top    = 0;
+  uint8_t bottom = row_size;
+  if (area->_rendered.font && area->_rendered.epoch == _epoch && area->_highlight.shown == area->_highlight.blend) {
+    top    = area->_rendered.top;
+    bottom = area->_rendered.bottom;
+  }
+
+  area->_rendered.font   = font;
+  area->_rendered.len    = textLen;
+  area->_rendered.start  = cursor;
+  area->_rendered.epoch  = _epoch;
+  area->_rendered.top    = row_size;
+  area->_rendered.bottom = 0;
+  memcpy(area->_rendered.text, text, textLen);
+
+  // Measure the scanlines of the text; the glyphs are rendered while the
+  // scanlines are sent.
   for (uint8_t i = 0; i < textLen; i++) {
-    const uint16_t advance = font->getGlyph(text[i])->advance;
-    if (_area.cursor + advance > _area.width)
+    const uint16_t advance = getAdvance(font, text[i], area->_tabular);
+    if (cursor + advance > area->_width)
       break;
 
-    renderChar(_buffer, font, _area.width, _area.cursor, baseline, text[i], _area.foreground);
-    _area.cursor += advance;
+    addBounds(font, text[i], area->_rendered.top, area->_rendered.bottom);
+    cursor += advance;
   }
 
-  _area.cursor = 0;
-  flushBuffer();
+  area->_highlight.shown = area->_highlight.blend;
+
+  top    = min(top, area->_rendered.top);
+  bottom = max(bottom, area->_rendered.bottom);
+  if (top < bottom) {
+    _resident = area;
+    flushBuffer(area, top, bottom, true);
+  }
+}
+
+// Render only the digits which differ from the text shown in the area, if the
+// layout of the text is unchanged. Every changed digit is rendered into its own
+// section of the offscreen buffer, and sent as a separate small window.
+bool V2Display::Display::updateDigits(TextArea *area,
+                                      const Font *font,
+                                      const char *text,
+                                      uint8_t len,
+                                      uint16_t start) {
+  if (!area->_tabular)
+    return false;
+
+  if (font != area->_rendered.font || area->_rendered.epoch != _epoch)
+    return false;
+
+  if (area->_highlight.shown != area->_highlight.blend)
+    return false;
+
+  if (len != area->_rendered.len || start != area->_rendered.start)
+    return false;
+
+  for (uint8_t i = 0; i < len; i++) {
+    if (text[i] == area->_rendered.text[i])
+      continue;
+
+    if (!isDigit(text[i]) || !isDigit(area->_rendered.text[i]))
+      return false;
+
+    // The pixels of a neighbour must not reach into the cell.
+    if (i > 0 && !isDigit(text[i - 1]) && !isContained(font, text[i - 1]))
+      return false;
+
+    if (i + 1 < len && !isDigit(text[i + 1]) && !isContained(font, text[i + 1]))
+      return false;
+  }
+
+  const uint8_t cell = getDigitAdvance(font);
+  uint16_t *pixels   = _buffer;
+  uint16_t x         = start;
+  bool prepared      = false;
+  for (uint8_t i = 0; i < len; i++) {
+    const uint8_t advance = getAdvance(font, text[i], true);
+    if (x + advance > area->_width)
+      break;
+
+    if (text[i] != area->_rendered.text[i]) {
+      for (uint16_t y = 0; y < row_size; y++)
+        fillPixels(pixels + (y * cell), getBackground(area, y), cell);
+
+      renderCell(pixels, font, cell, 0, text[i], getForeground(area), 0, cell, true);
+      if (area->_highlight.blend)
+        area->_highlight.blend->apply(pixels, cell * row_size);
+
+      if (!prepared) {
+        prepareWrite();
+        _resident = NULL;
+        prepared  = true;
+      }
+
+      // Send only the scanlines covered by the old or the new digit.
+      uint8_t top    = row_size;
+      uint8_t bottom = 0;
+      addBounds(font, text[i], top, bottom);
+      addBounds(font, area->_rendered.text[i], top, bottom);
+      if (top < bottom) {
+        writeSetWindow(area->_x + x, (area->_row * row_size) + top, cell, bottom - top);
+        write(pixels + (top * cell), cell * (bottom - top) * sizeof(uint16_t));
+      }
+
+      pixels += cell * row_size;
+      area->_rendered.text[i] = text[i];
+      area->_rendered.top     = min(area->_rendered.top, top);
+      area->_rendered.bottom  = max(area->_rendered.bottom, bottom);
+    }
+
+    x += advance;
+  }
+
+  if (prepared)
+    _busy = true;
+
+  return true;
+}
+
+// Render the visible part of the marquee text into the given columns.
+void V2Display::Display::renderMarquee(TextArea *area, uint16_t start, uint16_t end) {
+  initializeColumns(area, start, end);
+
+  for (int16_t x = -area->_marquee.offset; x < (int16_t)end; x += area->_marquee.period) {
+    int16_t cursor = x;
+    for (uint8_t i = 0; i < area->_marquee.len; i++)
+      cursor += renderCell(_buffer,
+                           area->_marquee.font,
+                           area->_width,
+                           cursor,
+                           area->_marquee.text[i],
+                           getForeground(area),
+                           start,
+                           end,
+                           area->_tabular);
+  }
+
+  if (area->_highlight.blend)
+    for (uint16_t y = 0; y < row_size; y++)
+      area->_highlight.blend->apply(_buffer + (y * area->_width) + start, end - start);
+
+  area->_highlight.shown = area->_highlight.blend;
+  _resident              = area;
+}
+
+// Moving the already rendered pixels and rendering only the exposed columns,
+// is a fraction of the cost of rendering the entire line.
+void V2Display::Display::renderScroll(TextArea *area, uint16_t columns) {
+  if (area->_marquee.len == 0)
+    return;
+
+  area->_marquee.offset = (area->_marquee.offset + columns) % area->_marquee.period;
+
+  if (_resident != area || columns >= area->_width || area->_highlight.shown != area->_highlight.blend) {
+    renderMarquee(area, 0, area->_width);
+
+  } else {
+    const uint16_t keep = area->_width - columns;
+    for (uint16_t y = 0; y < row_size; y++) {
+      uint16_t *line = _buffer + (y * area->_width);
+      memmove(line, line + columns, keep * sizeof(uint16_t));
+    }
+
+    renderMarquee(area, keep, area->_width);
+  }
+
+  flushBuffer(area);
+}
+
+// Composite the highlight over the line in the offscreen buffer, if it is still
+// there. Otherwise, render the line again.
+void V2Display::Display::renderHighlight(TextArea *area) {
+  if (area->_highlight.shown == area->_highlight.blend)
+    return;
+
+  if (_resident == area && !area->_highlight.shown) {
+    area->_highlight.blend->apply(_buffer, area->_width * row_size);
+    area->_highlight.shown = area->_highlight.blend;
+    flushBuffer(area);
+    return;
+  }
+
+  renderAgain(area);
+}
+
+// Render the shown text or marquee of the area with its current style.
+void V2Display::Display::renderAgain(TextArea *area) {
+  if (area->_marquee.len > 0) {
+    renderMarquee(area, 0, area->_width);
+    flushBuffer(area);
+    return;
+  }
+
+  renderText(area, area->_pending.text[0] == '\0' ? NULL : area->_pending.text);
+}
+
+void V2Display::Display::attach(TextArea *area) {
+  if (area->_attached)
+    return;
+
+  area->_link     = _areas;
+  area->_attached = true;
+  _areas          = area;
+}
+
+// Remove the area from the list of areas and from its queue. The area might
+// have changed its priority after it was queued, search all queues.
+void V2Display::Display::detach(TextArea *area) {
+  // The text of the area is still sent; render the remaining scanlines now.
+  if (_slicing.area == area)
+    completeBuffer();
+
+  if (_resident == area)
+    _resident = NULL;
+
+  if (area->_attached) {
+    TextArea *prev = NULL;
+    for (TextArea *a = _areas; a; prev = a, a = a->_link) {
+      if (a != area)
+        continue;
+
+      if (prev)
+        prev->_link = a->_link;
+
+      else
+        _areas = a->_link;
+
+      break;
+    }
+
+    area->_link     = NULL;
+    area->_attached = false;
+  }
+
+  if (!area->_queued)
+    return;
+
+  for (uint8_t p = 0; p < PriorityCount; p++) {
+    auto &queue    = _queue[p];
+    TextArea *prev = NULL;
+    for (TextArea *a = queue.first; a; prev = a, a = a->_next) {
+      if (a != area)
+        continue;
+
+      if (prev)
+        prev->_next = a->_next;
+
+      else
+        queue.first = a->_next;
+
+      if (queue.last == a)
+        queue.last = prev;
+
+      area->_next   = NULL;
+      area->_queued = false;
+      return;
+    }
+  }
+}
+
+void V2Display::Display::setBrightness(uint8_t level) {
+  if (level == _brightness.level)
+    return;
+
+  _brightness.level = level;
+
+  if (_brightness.hardware) {
+    prepareWrite();
+    writeSetBrightness(level);
+    finishWrite();
+    return;
+  }
+
+  _brightness.gamma.set(1, level / 255.f);
+
+  // Render the text of all areas with the scaled colors. Text which is not on
+  // the screen anymore, because the screen was cleared, stays hidden.
+  for (TextArea *area = _areas; area; area = area->_link) {
+    if (area->_pending.text[0] == '\0' || area->_rendered.epoch != _epoch)
+      continue;
+
+    // The shown text has different colors now.
+    area->_rendered.font   = NULL;
+    area->_pending.restyle = true;
+    enqueue(area);
+  }
+
+  dispatch();
+}
+
+void V2Display::Display::setHighlight(const Blend *blend) {
+  wait();
+  _area._highlight.blend = blend;
+  renderHighlight(&_area);
+}
+
+void V2Display::Display::print(const char s[]) {
+  if (!s)
+    return;
+
+  wait();
+  renderText(&_area, s);
+}
+
+void V2Display::Display::clear() {
+  wait();
+  renderText(&_area, NULL);
+}
+
+void V2Display::Display::scroll(uint8_t columns) {
+  wait();
+  renderScroll(&_area, columns);
+}
+
+// Format a fixed-point number, without pulling in the printf() machinery.
+static void formatFixed(char *s, uint32_t n, bool negative, uint8_t scale) {
+  if (scale > 9)
+    scale = 9;
+
+  // Digits in reverse order, at least one digit before the decimal point.
+  char digits[12];
+  uint8_t len = 0;
+  do {
+    digits[len++] = '0' + (n % 10);
+    n /= 10;
+  } while (n > 0 || len <= scale);
+
+  if (negative)
+    *s++ = '-';
+
+  while (len > 0) {
+    if (len == scale)
+      *s++ = '.';
+
+    *s++ = digits[--len];
+  }
+
+  *s = '\0';
+}
+
+static void formatFixed(char *s, int32_t value, uint8_t scale) {
+  formatFixed(s, value < 0 ? -(uint32_t)value : value, value < 0, scale);
+}
+
+// Called from an interrupt handler; the record is written before the head is
+// published.
+bool V2Display::Display::post(TextArea *area, int32_t value, uint8_t scale) {
+  const uint8_t head = _ring.head.load(std::memory_order_relaxed);
+  const uint8_t next = (head + 1) % ring_size;
+  if (next == _ring.tail.load(std::memory_order_acquire))
+    return false;
+
+  _ring.records[head].area  = area;
+  _ring.records[head].value = value;
+  _ring.records[head].scale = scale;
+  _ring.head.store(next, std::memory_order_release);
+  return true;
+}
+
+// Move the posted values to the areas, the latest value of an area wins.
+void V2Display::Display::receive() {
+  uint8_t tail = _ring.tail.load(std::memory_order_relaxed);
+  while (tail != _ring.head.load(std::memory_order_acquire)) {
+    TextArea *area      = _ring.records[tail].area;
+    const int32_t value = _ring.records[tail].value;
+    const uint8_t scale = _ring.records[tail].scale;
+
+    // Release the slot before the record is processed.
+    tail = (tail + 1) % ring_size;
+    _ring.tail.store(tail, std::memory_order_release);
+
+    char s[16];
+    formatFixed(s, value, scale);
+    area->setText(s);
+    enqueue(area);
+  }
+}
+
+// A float has ~7 significant digits, round it to a fixed-point number. The
+// integer part is split off before the fraction is scaled; scaling the entire
+// value would invent digits which the float does not have.
+static void formatFloat(char *s, float f, uint8_t digits) {
+  static constexpr uint32_t pow10[]{1, 10, 100, 1000, 10000, 100000, 1000000};
+
+  if (isnan(f)) {
+    strcpy(s, "nan");
+    return;
+  }
+
+  if (isinf(f)) {
+    strcpy(s, f < 0 ? "-inf" : "inf");
+    return;
+  }
+
+  if (digits > 6)
+    digits = 6;
+
+  // Values beyond the 32 bit integer range are printed with an exponent;
+  // "1.23e12". The mantissa might round up to the next power of ten.
+  if (fabsf(f) >= 4294967296.f) {
+    uint8_t exponent = 0;
+    while (fabsf(f) >= 10.f - (0.5f / pow10[digits])) {
+      f /= 10.f;
+      exponent++;
+    }
+
+    formatFloat(s, f, digits);
+    s += strlen(s);
+    *s++ = 'e';
+    formatFixed(s, exponent, false, 0);
+    return;
+  }
+
+  uint32_t integer  = fabsf(f);
+  uint32_t fraction = lroundf((fabsf(f) - integer) * pow10[digits]);
+  if (fraction == pow10[digits]) {
+    integer++;
+    fraction = 0;
+  }
+
+  formatFixed(s, integer, f < 0 && (integer > 0 || fraction > 0), 0);
+  if (digits == 0)
+    return;
+
+  s += strlen(s);
+  *s++ = '.';
+  for (uint8_t i = digits; i > 0; i--) {
+    s[i - 1] = '0' + (fraction % 10);
+    fraction /= 10;
+  }
+
+  s[digits] = '\0';
+}
+
+void V2Display::Display::printFixed(int32_t value, uint8_t scale) {
+  char s[16];
+  formatFixed(s, value, scale);
+  print(s);
+}
+
+void V2Display::Display::printFixed(uint32_t value, uint8_t scale) {
+  char s[16];
+  formatFixed(s, value, false, scale);
+  print(s);
 }
 
 void V2Display::Display::print(float f, uint8_t digits) {
-  char s[32];
-  snprintf(s, sizeof(s), "%.*f", digits, f);
+  char s[20];
+  formatFloat(s, f, digits);
+  print(s);
+}
+
+void V2Display::TextArea::set(uint16_t x,
+                              uint8_t row,
+                              uint16_t width,
+                              Justify justify,
+                              uint16_t foreground,
+                              uint16_t background) {
+  _x               = x;
+  _row             = row;
+  _width           = min(width, _display->_buffer_width);
+  _justify         = justify;
+  _foreground      = foreground;
+  _background      = background;
+  _shading.shading = Flat;
+  _cursor          = 0;
+  _rendered.font   = NULL;
+  _marquee.len     = 0;
+  _pending.text[0] = '\0';
+  _display->attach(this);
+}
+
+V2Display::TextArea::~TextArea() {
+  _display->detach(this);
+}
+
+void V2Display::TextArea::setText(const char s[]) {
+  if (s) {
+    strncpy(_pending.text, s, sizeof(_pending.text) - 1);
+    _pending.text[sizeof(_pending.text) - 1] = '\0';
+
+  } else
+    _pending.text[0] = '\0';
+
+  _pending.print  = true;
+  _pending.scroll = 0;
+}
+
+void V2Display::TextArea::print(const char s[]) {
+  if (!s || s[0] == '\0')
+    return;
+
+  setText(s);
+  _display->submit(this);
+}
+
+void V2Display::TextArea::clear() {
+  setText(NULL);
+  _display->submit(this);
+}
+
+void V2Display::TextArea::printFixed(int32_t value, uint8_t scale) {
+  char s[16];
+  formatFixed(s, value, scale);
   print(s);
 }
+
+void V2Display::TextArea::printFixed(uint32_t value, uint8_t scale) {
+  char s[16];
+  formatFixed(s, value, false, scale);
+  print(s);
+}
+
+bool V2Display::TextArea::post(int32_t value, uint8_t scale) {
+  return _display->post(this, value, scale);
+}
+
+#if __has_include(<FreeRTOS.h>)
+bool V2Display::TextArea::send(const char s[], TickType_t timeout) {
+  return _display->send(this, s, timeout);
+}
+#endif
+
+void V2Display::TextArea::print(float f, uint8_t digits) {
+  char s[20];
+  formatFloat(s, f, digits);
+  print(s);
+}
+
+void V2Display::TextArea::setHighlight(const Blend *blend) {
+  _highlight.blend   = blend;
+  _pending.highlight = true;
+  _display->submit(this);
+}
+
+void V2Display::TextArea::scroll(uint8_t columns) {
+  _pending.scroll += columns;
+  _display->submit(this);
+}
@@ -5,6 +5,23 @@
 
 #include <Arduino.h>
 #include <SPI.h>
+#include <atomic>
+#include <type_traits>
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#endif
+#if __has_include(<FreeRTOS.h>)
+#include <FreeRTOS.h>
+#include <queue.h>
+#include <task.h>
+#endif
+
+class Font;
+
+// The built-in fonts, DIN1451 in decreasing widths.
+extern const Font fontDefault;
+extern const Font fontCondensed;
+extern const Font fontCondensedSmall;
 
 namespace V2Display {
 // 16 bit RGB, 5:6:5.
@@ -20,9 +37,697 @@ enum {
   Orange  = 0xfc00,
 };
 
+// Convert 8 bit per channel RGB to 5:6:5.
+constexpr uint16_t rgb(uint8_t r, uint8_t g, uint8_t b) {
+  return ((((r * 31) + 127) / 255) << 11) | ((((g * 63) + 127) / 255) << 5) | (((b * 31) + 127) / 255);
+}
+
+// Convert a 0xrrggbb value to 5:6:5.
+constexpr uint16_t rgb(uint32_t rgb888) {
+  return rgb(rgb888 >> 16, (rgb888 >> 8) & 0xff, rgb888 & 0xff);
+}
+
+// Convert hue (0..359 degrees), saturation and value (0..255) to 5:6:5.
+constexpr uint16_t hsv(uint16_t h, uint8_t s, uint8_t v) {
+  h %= 360;
+  const uint8_t sector = h / 60;
+  const uint8_t f      = ((h % 60) * 255) / 60;
+  const uint8_t p      = (v * (255 - s)) / 255;
+  const uint8_t q      = (v * (255 - ((s * f) / 255))) / 255;
+  const uint8_t t      = (v * (255 - ((s * (255 - f)) / 255))) / 255;
+  switch (sector) {
+    case 0:
+      return rgb(v, t, p);
+    case 1:
+      return rgb(q, v, p);
+    case 2:
+      return rgb(p, v, t);
+    case 3:
+      return rgb(p, q, v);
+    case 4:
+      return rgb(t, p, v);
+    default:
+      return rgb(v, p, q);
+  }
+}
+
+// Gamma-corrected and scaled colors. The lookup tables for all channel
+// intensities are calculated once, converting a color needs no float math.
+class Gamma {
+public:
+  // Unchanged colors.
+  constexpr Gamma() {
+    for (uint8_t i = 0; i < 32; i++) {
+      _red[i]  = i;
+      _blue[i] = i;
+    }
+
+    for (uint8_t i = 0; i < 64; i++)
+      _green[i] = i;
+  }
+
+  Gamma(float gamma, float brightness = 1) {
+    set(gamma, brightness);
+  }
+
+  void set(float gamma, float brightness = 1);
+
+  uint16_t apply(uint16_t color) const {
+    return (_red[color >> 11] << 11) | (_green[(color >> 5) & 0x3f] << 5) | _blue[color & 0x1f];
+  }
+
+private:
+  uint8_t _red[32]{};
+  uint8_t _green[64]{};
+  uint8_t _blue[32]{};
+};
+
 // Text justification relative to the current text area.
 enum Justify { Left, Center, Right };
 
+// Handling of text which does not fit into the area with the smallest font.
+enum Overflow {
+  // Stop rendering at the edge of the area.
+  Clip,
+
+  // Cut the text and append "...".
+  Ellipsis,
+
+  // Render the start of the text, scroll() moves it to the left.
+  Marquee,
+};
+
+// The background of a text area, evaluated once per scanline.
+enum Shading {
+  // A single color.
+  Flat,
+
+  // A vertical gradient from the top to the bottom of the text row.
+  Gradient,
+
+  // Horizontal stripes of two alternating colors.
+  Stripes,
+};
+
+// The order in which Display::loop() serves queued text areas. An area is only
+// served if no area with a higher priority is waiting.
+enum Priority { Low, Normal, High, PriorityCount };
+
+// A translucent color, composited over rendered pixels. The blended values of all
+// channel intensities are precomputed, compositing a pixel needs three table
+// lookups; a constexpr instance places the tables in flash.
+class Blend {
+public:
+  // Alpha 0 (transparent) to 255 (opaque).
+  constexpr Blend(uint16_t color, uint8_t alpha) {
+    for (uint8_t i = 0; i < 32; i++) {
+      _red[i]  = mix(i, color >> 11, alpha);
+      _blue[i] = mix(i, color & 0x1f, alpha);
+    }
+
+    for (uint8_t i = 0; i < 64; i++)
+      _green[i] = mix(i, (color >> 5) & 0x3f, alpha);
+  }
+
+  constexpr uint16_t apply(uint16_t pixel) const {
+    return (_red[pixel >> 11] << 11) | (_green[(pixel >> 5) & 0x3f] << 5) | _blue[pixel & 0x1f];
+  }
+
+  // Composite a run of pixels in place.
+  void apply(uint16_t *pixels, uint32_t count) const;
+
+private:
+  uint8_t _red[32]{};
+  uint8_t _green[64]{};
+  uint8_t _blue[32]{};
+
+  static constexpr uint8_t mix(uint8_t value, uint8_t color, uint8_t alpha) {
+    return ((value * (255 - alpha)) + (color * alpha) + 127) / 255;
+  }
+};
+
+class Display;
+class TextArea;
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+// A coroutine which starts immediately and is destroyed when it returns. It is
+// resumed by Display::loop() when the display operation it awaits is complete.
+struct Task {
+  struct promise_type {
+    Task get_return_object() {
+      return {};
+    }
+    std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+    std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+    void return_void() {}
+    void unhandled_exception() {}
+  };
+};
+
+// A display operation to co_await. The suspended coroutines are kept in a list
+// of the display, the awaitable itself lives in the coroutine frame.
+class Awaitable {
+public:
+  bool await_ready() {
+    return step();
+  }
+
+  void await_suspend(std::coroutine_handle<> handle);
+  void await_resume() {}
+
+protected:
+  friend class Display;
+
+  constexpr Awaitable(Display *display) : _display(display) {}
+
+  Display *_display;
+  std::coroutine_handle<> _handle{};
+  Awaitable *_next{};
+
+  // Advance the operation, returns true when it is complete.
+  virtual bool step() = 0;
+};
+
+// All queued jobs are rendered and their pixels are sent.
+class FlushAwaitable : public Awaitable {
+public:
+  constexpr FlushAwaitable(Display *display) : Awaitable(display) {}
+
+private:
+  bool step() override;
+};
+
+// The pending text of the area is rendered and its pixels are sent.
+class PrintAwaitable : public Awaitable {
+public:
+  constexpr PrintAwaitable(Display *display, TextArea *area) : Awaitable(display), _area(area) {}
+
+private:
+  TextArea *_area;
+  bool step() override;
+};
+
+// The rectangle is filled when the display is idle, the awaiting coroutine is
+// resumed when its pixels are sent.
+class FillAwaitable : public Awaitable {
+public:
+  constexpr FillAwaitable(Display *display, uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t color) :
+    Awaitable(display),
+    _rectangle{.x{x}, .y{y}, .width{width}, .height{height}, .color{color}} {}
+
+private:
+  struct {
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint16_t color;
+  } _rectangle;
+  bool _started{};
+  uint32_t _job{};
+
+  bool step() override;
+};
+#endif
+
+// A text area on the display. Every area carries its own position, colors and
+// text handling, and remembers the text it shows. Printing to an area does not
+// block; if the display is busy, the text is queued and rendered by
+// Display::loop() after the currently running job has finished. Several areas
+// can have pending text at the same time; the latest text of an area replaces
+// its pending text. The display keeps a pointer to the area, it cannot be
+// copied; a destroyed area is removed from the display.
+class TextArea {
+public:
+  constexpr TextArea(Display *display) : _display(display) {}
+  ~TextArea();
+
+  TextArea(const TextArea &)            = delete;
+  TextArea &operator=(const TextArea &) = delete;
+
+  // Define the position and colors of the area. The width is limited to the
+  // width of the offscreen buffer of the display.
+  void set(uint16_t x, uint8_t row, uint16_t width, Justify justify, uint16_t foreground, uint16_t background);
+
+  void setOverflow(Overflow overflow) {
+    _overflow = overflow;
+  }
+
+  // Always use the given font, the text is not measured with other fonts.
+  void setFont(const Font *font) {
+    _fonts.pinned  = font;
+    _rendered.font = NULL;
+  }
+
+  // Use the first font of the list the text fits in, or the last one. The list
+  // is not copied. An empty list restores the default: fontDefault, fontCondensed,
+  // fontCondensedSmall.
+  void setFonts(const Font *const *fonts, uint8_t count) {
+    _fonts.list    = fonts;
+    _fonts.count   = count;
+    _fonts.pinned  = NULL;
+    _rendered.font = NULL;
+  }
+
+  void setColor(uint16_t color) {
+    _foreground    = color;
+    _rendered.font = NULL;
+  }
+
+  void setBackground(uint16_t color) {
+    _background      = color;
+    _shading.shading = Flat;
+    _rendered.font   = NULL;
+  }
+
+  void setGradient(uint16_t top, uint16_t bottom) {
+    _background      = top;
+    _shading.shading = Gradient;
+    _shading.color   = bottom;
+    _rendered.font   = NULL;
+  }
+
+  // Stripes of the given height in scanlines, starting with the first color.
+  void setStripes(uint16_t color, uint16_t stripe, uint8_t height) {
+    _background      = color;
+    _shading.shading = Stripes;
+    _shading.color   = stripe;
+    _shading.height  = height > 0 ? height : 1;
+    _rendered.font   = NULL;
+  }
+
+  // Render all digits with the same advance, numbers do not change their width
+  // and position when the value changes. A printed number with the same layout
+  // as the previous one, only updates the changed digits.
+  void setTabular(bool tabular) {
+    _tabular       = tabular;
+    _rendered.font = NULL;
+  }
+
+  // Serve the jobs of this area before the ones of lower priority areas. An
+  // area which is already queued keeps its position until it is served.
+  void setPriority(Priority priority) {
+    _priority = priority;
+  }
+
+  // Limit the number of printed lines per second, 0 disables the limit. Text
+  // printed faster is held back, the latest text is rendered when the interval
+  // has elapsed.
+  void setMaxRate(uint8_t hz) {
+    _throttle.interval_usec = hz > 0 ? 1000000 / hz : 0;
+
+    // The next print is not held back.
+    _throttle.printed_usec = micros() - _throttle.interval_usec;
+  }
+
+  // Queue a line of text. The text is rendered immediately if the display is
+  // idle.
+  void print(const char s[]);
+  void print(std::nullptr_t) = delete;
+  void print(float f, uint8_t digits = 2);
+
+  // Print an integer of up to 32 bits. With a scale, the value is a fixed-point
+  // number with the given number of fractional digits; print(-1234, 2) prints
+  // "-12.34". The template accepts all integer types without ambiguity with the
+  // float version.
+  template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+  void print(T value, uint8_t scale = 0) {
+    static_assert(sizeof(T) <= sizeof(uint32_t), "64 bit integers are not supported");
+    printFixed((typename std::conditional<std::is_signed<T>::value, int32_t, uint32_t>::type)value, scale);
+  }
+
+  // Print a value from an interrupt handler. The value is passed to the display
+  // through a lock-free ring and rendered with the next loop(). All areas of a
+  // display share the ring and need to be posted from the same context; an area
+  // must not be destroyed while it has posted values. Returns false if the ring
+  // is full.
+  bool post(int32_t value, uint8_t scale = 0);
+
+#if __has_include(<FreeRTOS.h>)
+  // Queue a line of text from any task, if the display runs its own task. The
+  // call blocks until the request fits into the queue or the timeout expires;
+  // the area must not be destroyed while the request is queued.
+  bool send(const char s[], TickType_t timeout = portMAX_DELAY);
+#endif
+
+  // Queue the clearing of the area.
+  void clear();
+
+  // Queue the move of the text of a marquee by the given number of pixel columns.
+  void scroll(uint8_t columns = 1);
+
+  // Composite a translucent color over the area, NULL removes it. The blend is
+  // not copied. If the line of the area is still in the offscreen buffer, the
+  // highlight is composited over it, the text is not rendered again.
+  void setHighlight(const Blend *blend);
+
+  // The area has a queued job, which is not rendered yet.
+  bool isPending() const {
+    return _queued;
+  }
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+  // Queue a line of text; co_await returns when it is shown.
+  PrintAwaitable printAsync(const char s[]) {
+    print(s);
+    return PrintAwaitable(_display, this);
+  }
+#endif
+
+private:
+  friend class Display;
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+  friend class PrintAwaitable;
+#endif
+
+  Display *_display;
+
+  // The queue of areas with pending jobs.
+  TextArea *_next{};
+  bool _queued{};
+  Priority _priority{Normal};
+  uint32_t _queued_usec{};
+
+  // The number of the last rendered job, see Display::getCompletedJobs().
+  uint32_t _job{};
+
+  struct {
+    uint32_t interval_usec;
+    uint32_t printed_usec;
+  } _throttle{};
+
+  uint16_t _x{};
+  uint8_t _row{};
+  uint16_t _width{};
+  Justify _justify{};
+  Overflow _overflow{};
+  uint16_t _foreground{};
+  uint16_t _background{};
+  bool _tabular{};
+
+  // The second color of a shaded background.
+  struct {
+    Shading shading;
+    uint16_t color;
+    uint8_t height;
+  } _shading{};
+
+  // The font list, or a single font from setFont() which replaces the list.
+  struct {
+    const Font *const *list;
+    uint8_t count;
+    const Font *pinned;
+  } _fonts{};
+
+  // The position of drawChar().
+  uint16_t _cursor{};
+
+  // All areas of the display.
+  TextArea *_link{};
+  bool _attached{};
+
+  // The job to render with the next loop(). The text is kept after it is
+  // rendered, to render it again with a different highlight or brightness.
+  struct {
+    bool print;
+    char text[32 + 1];
+    uint16_t scroll;
+    bool highlight;
+    bool restyle;
+  } _pending{};
+
+  // The requested highlight, and the one composited into the shown line.
+  struct {
+    const Blend *blend;
+    const Blend *shown;
+  } _highlight{};
+
+  // The text currently shown in the area. It is valid as long as the epoch
+  // matches the one of the display.
+  struct {
+    const Font *font;
+    char text[32 + 3];
+    uint8_t len;
+    uint16_t start;
+    uint32_t epoch;
+
+    // The scanlines covered by the glyphs.
+    uint8_t top;
+    uint8_t bottom;
+  } _rendered{};
+
+  // The text of the area, if it is scrolled.
+  struct {
+    const Font *font;
+    char text[32];
+    uint8_t len;
+    uint16_t period;
+    uint16_t offset;
+  } _marquee{};
+
+  uint16_t getBackground(uint8_t y) const;
+  const Font *const *getFonts() const;
+  uint8_t getFontsCount() const;
+  void printFixed(int32_t value, uint8_t scale);
+  void printFixed(uint32_t value, uint8_t scale);
+  void setText(const char s[]);
+};
+
+// An output pin. On SAMD, the port registers are resolved once, a change of the
+// pin state is a single store. A negative pin number is not connected.
+class Output {
+public:
+  void begin(int8_t pin, bool high);
+
+  void write(bool high) const {
+#ifdef ARDUINO_ARCH_SAMD
+    if (_set)
+      *(high ? _set : _clear) = _mask;
+#else
+    if (_pin >= 0)
+      digitalWrite(_pin, high ? HIGH : LOW);
+#endif
+  }
+
+private:
+#ifdef ARDUINO_ARCH_SAMD
+  volatile uint32_t *_set{};
+  volatile uint32_t *_clear{};
+  uint32_t _mask{};
+#else
+  int8_t _pin{-1};
+#endif
+};
+
+// The bus to the display controller. Commands and pixels are sent between
+// beginTransaction() and endTransaction(). write() sends 5:6:5 pixels stored in
+// CPU byte order, the high byte first. It might return while the data is still
+// being sent, isBusy() returns false when the transfer is complete.
+class Transport {
+public:
+  virtual void begin() {}
+  virtual void beginTransaction() {}
+  virtual void endTransaction() {}
+  virtual void writeCommand(uint8_t command, const uint8_t *data, uint8_t len) = 0;
+  virtual void write(const void *buffer, uint16_t len)                         = 0;
+  virtual bool isBusy() {
+    return false;
+  }
+};
+
+// 4-wire SPI, the DC pin selects command or data. If the SERCOM is passed
+// instead of a SPIClass, the bus is owned and its registers are written directly.
+class SPITransport : public Transport {
+public:
+  constexpr SPITransport() {}
+
+  constexpr SPITransport(SPIClass *spi, int8_t pin_cs, int8_t pin_dc) :
+    _spi{spi},
+    _pin{.cs{pin_cs}, .dc{pin_dc}} {}
+
+  constexpr SPITransport(uint8_t pin_data,
+                         uint8_t pin_clock,
+                         SERCOM *sercom,
+                         SercomSpiTXPad pad_tx,
+                         EPioType pin_func,
+                         int8_t pin_cs,
+                         int8_t pin_dc) :
+    _sercom{.pin{.data{pin_data}, .clock{pin_clock}}, .sercom{sercom}, .pad_tx{pad_tx}, .pin_func{pin_func}},
+    _pin{.cs{pin_cs}, .dc{pin_dc}} {}
+
+  void begin() override;
+  void beginTransaction() override;
+  void endTransaction() override;
+  void writeCommand(uint8_t command, const uint8_t *data, uint8_t len) override;
+  void write(const void *buffer, uint16_t len) override;
+  bool isBusy() override;
+
+private:
+  struct {
+    struct {
+      uint8_t data;
+      uint8_t clock;
+    } pin;
+    SERCOM *sercom;
+    SercomSpiTXPad pad_tx;
+    EPioType pin_func;
+  } _sercom{};
+
+  SPIClass *_spi{};
+
+#ifdef ARDUINO_ARCH_SAMD
+  // The registers of our own SERCOM, written directly instead of through SPIClass.
+  Sercom *_regs{};
+#endif
+
+  // Bytes were written to the SERCOM data register since the last drain().
+  bool _transmitting{};
+
+  struct {
+    int8_t cs;
+    int8_t dc;
+  } _pin{};
+
+  struct {
+    Output cs;
+    Output dc;
+  } _output{};
+
+  void transmit(uint8_t b);
+  void drain();
+};
+
+// 3-wire SPI without a DC pin, every byte is sent as a 9 bit frame; the first
+// bit selects command or data. The SERCOM is switched to 9 bit characters,
+// without a SERCOM the pins are driven by software.
+class SPI9BitTransport : public Transport {
+public:
+  constexpr SPI9BitTransport(uint8_t pin_data,
+                             uint8_t pin_clock,
+                             SERCOM *sercom,
+                             SercomSpiTXPad pad_tx,
+                             EPioType pin_func,
+                             int8_t pin_cs) :
+    _sercom{.pin{.data{pin_data}, .clock{pin_clock}}, .sercom{sercom}, .pad_tx{pad_tx}, .pin_func{pin_func}},
+    _pin_cs{pin_cs} {}
+
+  void begin() override;
+  void beginTransaction() override;
+  void endTransaction() override;
+  void writeCommand(uint8_t command, const uint8_t *data, uint8_t len) override;
+  void write(const void *buffer, uint16_t len) override;
+
+private:
+  struct {
+    struct {
+      uint8_t data;
+      uint8_t clock;
+    } pin;
+    SERCOM *sercom;
+    SercomSpiTXPad pad_tx;
+    EPioType pin_func;
+  } _sercom{};
+
+#ifdef ARDUINO_ARCH_SAMD
+  Sercom *_regs{};
+#endif
+
+  const int8_t _pin_cs;
+
+  struct {
+    Output cs;
+    Output data;
+    Output clock;
+  } _output{};
+
+  void transmit(bool data, uint8_t b);
+  void drain();
+};
+
+// 8 bit parallel 8080 bus, the data is latched with the rising edge of WR; RD
+// needs to be tied high. If the data pins are 8 consecutive bits of the same
+// port, a byte is written with one store, otherwise every pin is set separately.
+class ParallelTransport : public Transport {
+public:
+  constexpr ParallelTransport(const uint8_t pins_data[8], int8_t pin_wr, int8_t pin_cs, int8_t pin_dc) :
+    _pins_data{pins_data},
+    _pin{.wr{pin_wr}, .cs{pin_cs}, .dc{pin_dc}} {}
+
+  void begin() override;
+  void beginTransaction() override;
+  void endTransaction() override;
+  void writeCommand(uint8_t command, const uint8_t *data, uint8_t len) override;
+  void write(const void *buffer, uint16_t len) override;
+
+private:
+  const uint8_t *_pins_data;
+
+  const struct {
+    int8_t wr;
+    int8_t cs;
+    int8_t dc;
+  } _pin;
+
+  struct {
+    Output wr;
+    Output cs;
+    Output dc;
+    Output data[8];
+  } _output{};
+
+#ifdef ARDUINO_ARCH_SAMD
+  // The port of the data pins, if they are consecutive.
+  struct {
+    volatile uint32_t *set;
+    volatile uint32_t *clear;
+    uint8_t shift;
+  } _port{};
+#endif
+
+  void transmit(uint8_t b);
+};
+
+// Decodes the memory writes of the MIPI DCS commands into a framebuffer, to
+// run the rendering without a display. The framebuffer has the size of the
+// controller's memory.
+class SimulatorTransport : public Transport {
+public:
+  constexpr SimulatorTransport(uint16_t *pixels, uint16_t width, uint16_t height) :
+    _pixels{pixels},
+    _width{width},
+    _height{height} {}
+
+  void writeCommand(uint8_t command, const uint8_t *data, uint8_t len) override;
+  void write(const void *buffer, uint16_t len) override;
+
+  // The number of bytes sent over the bus.
+  uint32_t getBytes() const {
+    return _bytes;
+  }
+
+private:
+  uint16_t *_pixels;
+  const uint16_t _width;
+  const uint16_t _height;
+  uint8_t _command{};
+
+  struct {
+    uint16_t start;
+    uint16_t end;
+  } _column{}, _row{};
+
+  struct {
+    uint16_t x;
+    uint16_t y;
+  } _cursor{};
+
+  uint32_t _bytes{};
+};
+
 class Display {
 public:
   // Pixels per text line. It matches the built-in font. A pixel buffer for a
@@ -40,11 +745,13 @@ public:
                     int8_t pin_cs,
                     int8_t pin_dc,
                     int8_t pin_reset) :
-    _pin{.cs{pin_cs}, .dc{pin_dc}, .reset{pin_reset}},
-    _sercom{},
-    _spi{spi},
+    _spi{spi, pin_cs, pin_dc},
+    _transport{&_spi},
+    _pin{.reset{pin_reset}},
     _hardware{.width{width}, .height{height}, .y_centered{y_centered}},
-    _buffer{} {}
+    _area{this},
+    _buffer{},
+    _buffer_width{width} {}
 
   constexpr Display(uint16_t width,
                     uint16_t height,
@@ -57,37 +764,183 @@ public:
                     int8_t pin_cs,
                     int8_t pin_dc,
                     int8_t pin_reset) :
-    _pin{.cs{pin_cs}, .dc{pin_dc}, .reset{pin_reset}},
-    _sercom{.pin{.data{pin_data}, .clock{pin_clock}}, .sercom{sercom}, .pad_tx{pad_tx}, .pin_func{pin_func}},
-    _spi{},
+    _spi{pin_data, pin_clock, sercom, pad_tx, pin_func, pin_cs, pin_dc},
+    _transport{&_spi},
+    _pin{.reset{pin_reset}},
     _hardware{.width{width}, .height{height}, .y_centered{y_centered}},
-    _buffer{} {}
+    _area{this},
+    _buffer{},
+    _buffer_width{width} {}
+
+  // A display connected to a different bus.
+  constexpr Display(uint16_t width, uint16_t height, bool y_centered, Transport *transport, int8_t pin_reset) :
+    _transport{transport},
+    _pin{.reset{pin_reset}},
+    _hardware{.width{width}, .height{height}, .y_centered{y_centered}},
+    _area{this},
+    _buffer{},
+    _buffer_width{width} {}
+
+  // A statically allocated offscreen buffer, a line of text of the given width.
+  template <uint16_t width> struct Buffer {
+    alignas(4) uint16_t pixels[width * row_size];
+  };
+
+  // Allocates the offscreen buffer and initializes the bus. Returns false if the
+  // buffer cannot be allocated. The buffer is as wide as the display; text areas
+  // are limited to the width of the buffer.
+  bool begin();
+
+  // Use a static buffer instead of allocating one. Returns false if the buffer is
+  // narrower than the display. Areas wider than the display, with the display
+  // rotated by 90 or 270 degrees, need a buffer as wide as its height.
+  template <uint16_t width> bool begin(Buffer<width> &buffer) {
+    if (width < _hardware.width)
+      return false;
+
+    return begin(buffer.pixels, width);
+  }
 
-  void begin();
   void reset(uint16_t orientation, uint16_t color);
+
+  // Finish the running job, and render the next queued text area.
   void loop();
+
+  // Called from loop() once for every job whose pixels have been sent; never
+  // from other calls. The handler may submit new jobs. Jobs which complete in
+  // other calls, or while the handler runs, are reported with the next loop().
+  void setCompletionHandler(void (*handler)(void *context), void *context = NULL) {
+    _completion.handler = handler;
+    _completion.context = context;
+  }
+
+  // The number of completed jobs; it can be polled instead of using a handler.
+  uint32_t getCompletedJobs() const {
+    return _completion.count;
+  }
+
+  // Render and send a text line in slices of scanlines, loop() returns when the
+  // given number of microseconds is used up. The next slice is sent with the
+  // next loop(). A budget of 0 sends the entire line at once.
+  void setTimeBudget(uint16_t usec) {
+    _slicing.budget = usec;
+  }
+
+  struct Stats {
+    uint32_t jobs;
+    uint32_t slices;
+
+    // The largest number of slices a single job needed.
+    uint16_t max_slices;
+
+    // The number of frames which held back a job because of the frame budget.
+    uint32_t deferred;
+  };
+
+  const Stats &getStats() const {
+    return _slicing.stats;
+  }
+
+  // Spread the pixel transfers over frames. Every frame, queued jobs are started
+  // until the given share of the bus capacity is used; the remaining jobs keep
+  // their order in the queue and are started in the next frames. A job which
+  // exceeds the budget is charged to the following frames. A rate of 0 removes
+  // the limit. 240 * 240 pixels are 115200 bytes; 7.5 MB/s at 60 Mhz.
+  void setFrameRate(uint8_t fps, uint8_t percent = 50, uint32_t bus_hz = 60000000) {
+    _frame.period_usec = fps > 0 ? 1000000 / fps : 0;
+    _frame.budget      = fps > 0 ? (uint64_t)bus_hz / 8 / fps * percent / 100 : 0;
+    _frame.credit      = _frame.budget;
+    _frame.start_usec  = micros();
+  }
+
+  // The time the jobs of a priority class waited in the queue.
+  struct Latency {
+    uint32_t jobs;
+    uint32_t total_usec;
+    uint32_t max_usec;
+  };
+
+  const Latency &getLatency(Priority priority) const {
+    return _latency[priority];
+  }
+
   void fillRectangle(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t color);
   void fillScreen(uint16_t color) {
     fillRectangle(0, 0, _pixels.width, _pixels.height, color);
   }
 
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+  // Awaitable operations, the awaiting coroutines are resumed by loop().
+  FlushAwaitable flush() {
+    return FlushAwaitable(this);
+  }
+
+  FillAwaitable fillRectangleAsync(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t color) {
+    return FillAwaitable(this, x, y, width, height, color);
+  }
+#endif
+
+#if __has_include(<FreeRTOS.h>)
+  // Run loop() in a dedicated task, which owns the bus; loop() must not be
+  // called anymore, other tasks use TextArea::send(). The task sleeps while
+  // there is nothing to do and while a transfer is running. Returns false if
+  // the task or the queue cannot be created.
+  bool beginTask(UBaseType_t priority, uint16_t stack_size = 512, uint8_t queue_length = 8);
+
+  // Wake up the display task from an interrupt handler; after a DMA transfer
+  // has completed, or after TextArea::post().
+  void notifyFromISR();
+#endif
+
+  // Dim the display, 255 is full brightness. If the hardware controls the
+  // backlight, no pixels are sent. Otherwise all colors are scaled when they are
+  // rendered; the text areas are queued to render their text again, other
+  // content keeps its colors until it is drawn again.
+  void setBrightness(uint8_t level);
+
   // Define the current area to draw text. The cursor is set to 0.
   void setArea(uint16_t x, uint8_t row, uint16_t width, Justify justify, uint16_t foreground, uint16_t background) {
-    _area.x          = x;
-    _area.row        = row;
-    _area.width      = width;
-    _area.justify    = justify;
-    _area.foreground = foreground;
-    _area.background = background;
-    _area.cursor     = 0;
+    _area.set(x, row, width, justify, foreground, background);
+  }
+
+  void setOverflow(Overflow overflow) {
+    _area.setOverflow(overflow);
   }
 
   void setColor(uint16_t color) {
-    _area.foreground = color;
+    _area.setColor(color);
+  }
+
+  void setTabular(bool tabular) {
+    _area.setTabular(tabular);
+  }
+
+  void setBackground(uint16_t color) {
+    _area.setBackground(color);
+  }
+
+  void setGradient(uint16_t top, uint16_t bottom) {
+    _area.setGradient(top, bottom);
+  }
+
+  void setStripes(uint16_t color, uint16_t stripe, uint8_t height) {
+    _area.setStripes(color, stripe, height);
+  }
+
+  // Composite a translucent color over the current area, see TextArea::setHighlight().
+  void setHighlight(const Blend *blend);
+
+  void setFont(const Font *font) {
+    _area.setFont(font);
+  }
+
+  void setFonts(const Font *const *fonts, uint8_t count) {
+    _area.setFonts(fonts, count);
   }
 
   // Draw a single character at the cursor position in the defined area. No text
-  // handling, always the default font size, left-justified.
+  // handling, always the first font of the area, left-justified. Queued text
+  // areas are not rendered until the characters are flushed with clear().
   void drawChar(char c);
 
   // Print a line of text into the defined area.
@@ -100,28 +953,43 @@ public:
   //
   // If the display is busy, the call will block until the currently running job
   // has finished, and this job can be offloaded.
-  void print(const char s[] = NULL);
+  void print(const char s[]);
+  void print(std::nullptr_t) = delete;
   void print(float f, uint8_t digits = 2);
 
+  // Clear the area, or show the characters from drawChar().
+  void clear();
+
+  // Print an integer of up to 32 bits, or a fixed-point number; see TextArea::print().
+  template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+  void print(T value, uint8_t scale = 0) {
+    static_assert(sizeof(T) <= sizeof(uint32_t), "64 bit integers are not supported");
+    printFixed((typename std::conditional<std::is_signed<T>::value, int32_t, uint32_t>::type)value, scale);
+  }
+
+  // Move the text of a marquee by the given number of pixel columns. The
+  // rendered line is shifted in the offscreen buffer, only the newly exposed
+  // columns are rendered.
+  void scroll(uint8_t columns = 1);
+
 protected:
-  struct {
-    struct {
-      const uint8_t data;
-      const uint8_t clock;
-    } pin;
-    SERCOM *sercom;
-    const SercomSpiTXPad pad_tx;
-    const EPioType pin_func;
-  } _sercom{};
+  // Use a static buffer with scanlines of the given width.
+  bool begin(uint16_t *pixels, uint16_t width) {
+    _buffer       = pixels;
+    _buffer_width = width;
+    return begin();
+  }
 
-  SPIClass *_spi{};
+  // The built-in SPI bus, if no other transport is given.
+  SPITransport _spi;
+  Transport *_transport;
 
   const struct {
-    int8_t cs;
-    int8_t dc;
     int8_t reset;
   } _pin;
 
+  Output _reset{};
+
   // Physical properties of the display hardware.
   const struct {
     uint16_t width;
@@ -138,15 +1006,17 @@ protected:
   } _pixels{};
 
   // Current text area.
+  TextArea _area;
+
   struct {
-    Justify justify;
-    uint16_t x;
-    uint8_t row;
-    uint16_t width;
-    uint16_t foreground;
-    uint16_t background;
-    uint16_t cursor;
-  } _area{};
+    uint8_t level{255};
+
+    // The hardware implementation controls the backlight.
+    bool hardware;
+
+    // The scaled colors, if the brightness is not controlled by the hardware.
+    Gamma gamma;
+  } _brightness{};
 
   // SPI functions called by the hardware implementation.
   void prepareWrite();
@@ -157,15 +1027,276 @@ protected:
   virtual void writeReset()                                                            = 0;
   virtual void writeSetOrientation(uint16_t angle)                                     = 0;
   virtual void writeSetWindow(uint16_t x, uint16_t y, uint16_t width, uint16_t height) = 0;
+  virtual void writeSetBrightness(uint8_t) {}
 
 private:
+  friend class TextArea;
+  friend class Digits;
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+  friend class Awaitable;
+  friend class FlushAwaitable;
+  friend class PrintAwaitable;
+  friend class FillAwaitable;
+
+  // Suspended coroutines, in the order they started to wait.
+  struct {
+    Awaitable *first;
+    Awaitable *last;
+  } _waiters{};
+
+  void resume();
+
+  // The job with the given number has finished.
+  bool isCompleted(uint32_t job) const {
+    return (int32_t)(_completion.count - job) >= 0;
+  }
+#endif
+
   bool _busy{};
+
+  // The offscreen buffer is sent in slices.
+  struct {
+    uint16_t budget;
+    const uint16_t *pixels;
+    uint32_t remaining;
+    uint16_t scanline;
+    uint16_t count;
+    Stats stats;
+
+    // The area whose text is rendered into the scanlines before they are sent,
+    // with a copy of its style.
+    const TextArea *area;
+    const Font *font;
+    const Blend *blend;
+    bool tabular;
+    uint16_t foreground;
+    uint16_t background[row_size];
+
+    // The range of sent scanlines, and the next scanline to render.
+    uint8_t top;
+    uint8_t bottom;
+    uint8_t rendered;
+  } _slicing{};
+
+  struct {
+    void (*handler)(void *context);
+    void *context;
+    uint32_t count;
+    uint32_t reported;
+  } _completion{};
   uint16_t *_buffer;
 
+  // The number of pixels of a scanline of the offscreen buffer.
+  uint16_t _buffer_width;
+
+  // All text areas which have been set up.
+  TextArea *_areas{};
+
+  // Text areas with pending jobs, one queue per priority, in submission order.
+  struct {
+    TextArea *first;
+    TextArea *last;
+  } _queue[PriorityCount]{};
+
+  Latency _latency[PriorityCount]{};
+
+  // The bytes which can be sent in the current frame, negative if a job has
+  // exceeded the budget of the previous frames.
+  struct {
+    uint32_t period_usec;
+    uint32_t start_usec;
+    uint32_t budget;
+    int32_t credit;
+
+    // A job was held back in the current frame.
+    bool deferred;
+  } _frame{};
+
+  // Values posted from an interrupt handler. Single producer, loop() is the
+  // consumer; the producer owns the head, the consumer the tail.
+  static constexpr uint8_t ring_size = 16;
+  struct {
+    struct {
+      TextArea *area;
+      int32_t value;
+      uint8_t scale;
+    } records[ring_size];
+    std::atomic<uint8_t> head;
+    std::atomic<uint8_t> tail;
+  } _ring{};
+
+#if __has_include(<FreeRTOS.h>)
+  struct Request {
+    TextArea *area;
+    char text[32 + 1];
+  };
+
+  struct {
+    TaskHandle_t handle;
+    QueueHandle_t queue;
+  } _task{};
+
+  static void runTask(void *display);
+  bool send(TextArea *area, const char s[], TickType_t timeout);
+#endif
+
+  // Incremented with every reset of the controller, it invalidates the text
+  // remembered by the areas. A filled rectangle invalidates the areas it covers.
+  uint32_t _epoch{};
+
+  // The area whose currently shown line is still in the offscreen buffer.
+  TextArea *_resident{};
+
+  // drawChar() rendered characters which are not flushed yet.
+  bool _drawing{};
+
+  bool poll();
+  void wait();
+  void report();
+  void dispatch();
+  void enqueue(TextArea *area);
+  TextArea *dequeue();
+  bool hasCredit();
+  bool isThrottled(const TextArea *area, uint32_t now) const;
+  bool isDue() const;
+  bool isQueued() const;
+  void submit(TextArea *area);
+  bool post(TextArea *area, int32_t value, uint8_t scale);
+  void receive();
   void write(const void *buffer, uint16_t len);
   void writeFillRectangle(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t color);
-  void initializeBuffer();
-  void flushBuffer();
+  void initializeBuffer(TextArea *area);
+  void initializeColumns(TextArea *area, uint16_t start, uint16_t end);
+  void flushBuffer(TextArea *area, uint8_t top = 0, uint8_t bottom = row_size, bool render = false);
+  void writeSlice();
+
+  // The running job has scanlines to render or to send.
+  bool isSliced() const {
+    return _slicing.remaining > 0 || _slicing.area;
+  }
+
+  void renderScanline(uint8_t y);
+  void completeBuffer();
+  void renderText(TextArea *area, const char s[]);
+  void renderMarquee(TextArea *area, uint16_t start, uint16_t end);
+  void renderScroll(TextArea *area, uint16_t columns);
+  void renderHighlight(TextArea *area);
+  void renderAgain(TextArea *area);
+  void attach(TextArea *area);
+  void detach(TextArea *area);
+
+  uint16_t dim(uint16_t color) const {
+    return !_brightness.hardware && _brightness.level < 255 ? _brightness.gamma.apply(color) : color;
+  }
+
+  uint16_t getForeground(const TextArea *area) const {
+    return dim(area->_foreground);
+  }
+
+  uint16_t getBackground(const TextArea *area, uint8_t y) const {
+    return dim(area->getBackground(y));
+  }
+  bool updateDigits(TextArea *area, const Font *font, const char *text, uint8_t len, uint16_t start);
+  void printFixed(int32_t value, uint8_t scale);
+  void printFixed(uint32_t value, uint8_t scale);
+
+  static uint16_t renderChar(uint16_t *buffer,
+                             const Font *font,
+                             uint16_t width,
+                             int16_t x,
+                             uint16_t y,
+                             uint8_t c,
+                             uint16_t color,
+                             uint16_t clip_start,
+                             uint16_t clip_end,
+                             uint16_t clip_top    = 0,
+                             uint16_t clip_bottom = row_size);
+  static uint16_t renderCell(uint16_t *buffer,
+                             const Font *font,
+                             uint16_t width,
+                             int16_t x,
+                             uint8_t c,
+                             uint16_t color,
+                             uint16_t clip_start,
+                             uint16_t clip_end,
+                             bool tabular,
+                             uint16_t clip_top    = 0,
+                             uint16_t clip_bottom = row_size);
+};
+
+// Numeric readout with a fixed number of digits, for values which change at a
+// high rate. All digits are rendered once into a cache, in the current colors;
+// printing a value sends only the changed digits, cropped to the height of the
+// digit glyphs, directly from the cache.
+class Digits {
+public:
+  constexpr Digits(Display *display) : _display(display) {}
+
+  // The digits are placed at the given x position in the text row. Allocates the
+  // cache for the pre-rendered digits, returns false if it cannot be allocated.
+  bool begin(uint16_t x,
+             uint8_t row,
+             uint8_t n_digits,
+             uint16_t foreground,
+             uint16_t background,
+             const Font *font = &fontDefault) {
+    return begin(NULL, 0, x, row, n_digits, foreground, background, font);
+  }
+
+  // Use a static cache instead of allocating one. It holds 11 digits of the size
+  // of the widest digit of the font; fontDefault needs 11 * 26 * 36 pixels.
+  // Returns false if the cache is too small.
+  template <size_t n>
+  bool begin(uint16_t (&cache)[n],
+             uint16_t x,
+             uint8_t row,
+             uint8_t n_digits,
+             uint16_t foreground,
+             uint16_t background,
+             const Font *font = &fontDefault) {
+    return begin(cache, n, x, row, n_digits, foreground, background, font);
+  }
+
+  // Render the cache with new colors, the next print() redraws all digits.
+  void setColors(uint16_t foreground, uint16_t background);
+
+  // Leading zeros are blank. Values which do not fit show all nines.
+  void print(uint32_t value);
+
+private:
+  Display *_display;
+  const Font *_font{};
+  uint16_t *_cache{};
+
+  // The number of pixels the cache holds, and if it was allocated by begin().
+  uint32_t _cache_size{};
+  bool _allocated{};
+
+  uint16_t _x{};
+  uint8_t _row{};
+  uint8_t _n_digits{};
+  uint16_t _foreground{};
+  uint16_t _background{};
+
+  // The brightness of the display the cache was rendered with.
+  uint8_t _level{};
+
+  // The size of one digit in the cache.
+  uint8_t _width{};
+  uint8_t _top{};
+  uint8_t _height{};
+
+  // The digits currently shown, 10 is blank.
+  uint8_t _shown[10]{};
+
+  bool begin(uint16_t *cache,
+             uint32_t cache_size,
+             uint16_t x,
+             uint8_t row,
+             uint8_t n_digits,
+             uint16_t foreground,
+             uint16_t background,
+             const Font *font);
 };
 
 // Sitronix ST7789V, 240 x 320 pixel graphics controller. Connected displays with fewer
@@ -195,12 +1326,82 @@ public:
                    int8_t pin_reset) :
     Display(width, height, y_centered, pin_data, pin_clock, sercom, pad_tx, pin_func, pin_cs, pin_dc, pin_reset) {}
 
+  constexpr ST7789(uint16_t width, uint16_t height, bool y_centered, Transport *transport, int8_t pin_reset) :
+    Display(width, height, y_centered, transport, pin_reset) {}
+
   void enable(boolean on);
   void sleep(boolean on);
 
+  // Some modules drive the backlight with the LEDPWM output of the controller,
+  // setBrightness() can use the display brightness register.
+  void useBrightnessControl(bool on);
+
+protected:
+  // Set the window in controller memory coordinates.
+  void writeWindow(uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+
 private:
   void writeReset() override;
+  void writeSetBrightness(uint8_t level) override;
   void writeSetOrientation(uint16_t angle) override;
   void writeSetWindow(uint16_t x, uint16_t y, uint16_t width, uint16_t height) override;
 };
+
+// A ST7789 display with the geometry and orientation fixed at compile time. The
+// window offsets are constants, and the offscreen buffer is part of the object;
+// begin() does not allocate memory.
+template <uint16_t width, uint16_t height, bool y_centered, uint16_t orientation = 0>
+class ST7789Fixed : public ST7789 {
+  static_assert(width > 0 && width <= 240 && height > 0 && height <= 320, "Unsupported geometry");
+  static_assert(orientation == 0 || orientation == 90 || orientation == 180 || orientation == 270,
+                "Unsupported orientation");
+
+public:
+  // Visible pixels in the fixed orientation.
+  static constexpr bool rotated          = orientation == 90 || orientation == 270;
+  static constexpr uint16_t pixel_width  = rotated ? height : width;
+  static constexpr uint16_t pixel_height = rotated ? width : height;
+
+  // The position of the visible pixels in controller memory; the same as
+  // ST7789::writeSetOrientation().
+  static constexpr uint16_t x_start = orientation == 0   ? (240 - width) / 2
+                                      : orientation == 90  ? (y_centered ? (320 - height) / 2 : 0)
+                                      : orientation == 180 ? ((240 - width) + 1) / 2
+                                                           : (y_centered ? (320 - height) / 2 : 320 - height);
+  static constexpr uint16_t y_start = orientation == 0   ? (y_centered ? (320 - height) / 2 : 0)
+                                      : orientation == 90  ? ((240 - width) + 1) / 2
+                                      : orientation == 180 ? (y_centered ? (320 - height) / 2 : 320 - height)
+                                                           : (240 - width) / 2;
+
+  constexpr ST7789Fixed(SPIClass *spi, int8_t pin_cs, int8_t pin_dc, int8_t pin_reset) :
+    ST7789(width, height, y_centered, spi, pin_cs, pin_dc, pin_reset) {}
+
+  constexpr ST7789Fixed(uint8_t pin_data,
+                        uint8_t pin_clock,
+                        SERCOM *sercom,
+                        SercomSpiTXPad pad_tx,
+                        EPioType pin_func,
+                        int8_t pin_cs,
+                        int8_t pin_dc,
+                        int8_t pin_reset) :
+    ST7789(width, height, y_centered, pin_data, pin_clock, sercom, pad_tx, pin_func, pin_cs, pin_dc, pin_reset) {}
+
+  constexpr ST7789Fixed(Transport *transport, int8_t pin_reset) : ST7789(width, height, y_centered, transport, pin_reset) {}
+
+  // The buffer is as wide as the lines of the fixed orientation.
+  bool begin() {
+    return Display::begin(_line.pixels, pixel_width);
+  }
+
+  void reset(uint16_t color) {
+    Display::reset(orientation, color);
+  }
+
+private:
+  Buffer<rotated ? height : width> _line;
+
+  void writeSetWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h) override {
+    writeWindow(x + x_start, y + y_start, w, h);
+  }
+};
 };